@@ -0,0 +1,111 @@
+#include "concurrent_priority_queue.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Measures how ConcurrentPriorityQueue scales with the number of
+ * threads. Every thread alternates insert() and deleteMin() on a
+ * queue that was filled beforehand, so its size stays about the
+ * same for the whole run.
+ *
+ * The same workload also runs on one PriorityQueue behind a single
+ * std::mutex, which is what the MultiQueue is meant to beat.
+ */
+
+// Spreads key number @n over the key space. Multiplying by an odd
+// constant is a bijection, so distinct numbers give distinct keys.
+static unsigned makeKey(unsigned n)
+{
+    return n * 2654435761u;
+}
+
+class LockedQueue
+{
+public:
+    explicit LockedQueue(unsigned maxSize) : queue(maxSize) {}
+
+    bool insert(unsigned key, unsigned value) {
+        std::lock_guard<std::mutex> guard(lock);
+        return queue.insert(key, value);
+    }
+
+    bool deleteMin(unsigned& key, unsigned& value) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (queue.numElements() == 0) {
+            return false;
+        }
+        key = *(queue.getMinKey());
+        value = *(queue.getMinValue());
+        return queue.deleteMin();
+    }
+
+private:
+    std::mutex lock;
+    PriorityQueue<unsigned> queue;
+};
+
+/**
+ * Runs @numThreads threads doing @opsPerThread insert()/deleteMin()
+ * pairs each on @queue, after filling it with @prefill elements.
+ * Returns millions of operations per second.
+ */
+template <typename Queue>
+double run(Queue& queue, unsigned numThreads, unsigned prefill, unsigned opsPerThread)
+{
+    // Key numbers below @prefill belong to the fill; after that,
+    // thread t takes every numThreads-th number starting at t.
+    for (unsigned i = 0; i < prefill; ++i) {
+        queue.insert(makeKey(i), i);
+    }
+
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < numThreads; ++t) {
+        workers.emplace_back([&queue, t, numThreads, prefill, opsPerThread]() {
+            unsigned key;
+            unsigned value;
+            for (unsigned i = 0; i < opsPerThread; ++i) {
+                queue.insert(makeKey(prefill + i * numThreads + t), i);
+                queue.deleteMin(key, value);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return 2.0 * numThreads * opsPerThread / seconds / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned max_threads = argc > 1 ? (unsigned) std::atoi(argv[1])
+                                    : std::thread::hardware_concurrency();
+    if (max_threads == 0) {
+        max_threads = 1;
+    }
+    const unsigned prefill = 1u << 20;
+    const unsigned ops_per_thread = 1u << 19;
+
+    std::printf("%u hardware threads, %u prefilled, %u insert/deleteMin pairs per thread\n",
+                std::thread::hardware_concurrency(), prefill, ops_per_thread);
+    std::printf("threads  multiqueue  strict  mutex   (Mops/s)\n");
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        ConcurrentPriorityQueue<unsigned> relaxed(2 * prefill, threads);
+        ConcurrentPriorityQueue<unsigned> strict(2 * prefill, threads, 2, 2, true);
+        LockedQueue locked(2 * prefill);
+        double relaxed_rate = run(relaxed, threads, prefill, ops_per_thread);
+        double strict_rate = run(strict, threads, prefill, ops_per_thread);
+        double locked_rate = run(locked, threads, prefill, ops_per_thread);
+        std::printf("%7u  %10.2f  %6.2f  %5.2f\n", threads, relaxed_rate, strict_rate, locked_rate);
+    }
+}
+
+/* Run code using following commands
+ * g++ -Wall -Werror -O2 -std=c++14 -pthread bench_concurrent_priority_queue.cpp -o bench_concurrent_priority_queue
+ * ./bench_concurrent_priority_queue [max threads]
+ */
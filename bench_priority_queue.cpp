@@ -0,0 +1,670 @@
+#include "priority_queue.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <new>
+#include <queue>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Benchmarks PriorityQueue on the workloads it is used for:
+ * Dijkstra, Prim and A* (insert/decreaseKey/deleteMin) on generated
+ * road-like and power-law graphs, and a discrete-event simulation
+ * trace with increaseKey/remove churn.
+ *
+ * Every workload also runs on std::priority_queue with lazy deletion
+ * (stale entries are skipped when they reach the top). Each run
+ * reports operations per second, peak heap memory, and a latency
+ * histogram per operation. Throughput and latency come from
+ * separate passes, so timing each operation does not slow down the
+ * throughput numbers.
+ */
+
+// Heap accounting: every allocation made by this program goes through here.
+static std::size_t heap_live = 0;
+static std::size_t heap_peak = 0;
+
+void* operator new(std::size_t size)
+{
+    void* p = std::malloc(size + 16);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    *(std::size_t*) p = size;
+    heap_live += size;
+    if (heap_live > heap_peak) {
+        heap_peak = heap_live;
+    }
+    return (char*) p + 16;
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p == nullptr) {
+        return;
+    }
+    // Go through an integer so the compiler does not treat the size header
+    // as an out-of-bounds read of the caller's object.
+    void* block = (void*)((std::uintptr_t) p - 16);
+    heap_live -= *(std::size_t*) block;
+    std::free(block);
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
+
+typedef std::chrono::steady_clock Clock;
+
+enum Op { OP_INSERT, OP_CHANGE, OP_REMOVE, OP_DELETE_MIN, NUM_OP };
+static const char* const op_name[NUM_OP] = {"insert", "change-key", "remove", "deleteMin"};
+
+/**
+ * Latency histogram with one bucket per power of two nanoseconds.
+ */
+struct Histogram
+{
+    static const unsigned NUM_BUCKET = 40;
+    unsigned long long bucket[NUM_BUCKET] = {};
+    unsigned long long count = 0;
+    unsigned long long max_ns = 0;
+
+    void record(unsigned long long ns) {
+        unsigned b = 0;
+        while (b + 1 < NUM_BUCKET && (1ULL << (b + 1)) <= ns) {
+            b++;
+        }
+        bucket[b]++;
+        count++;
+        if (ns > max_ns) {
+            max_ns = ns;
+        }
+    }
+
+    // Upper bound of the bucket that holds quantile @q.
+    unsigned long long quantile(double q) const {
+        unsigned long long target = (unsigned long long)(q * count);
+        unsigned long long seen = 0;
+        for (unsigned b = 0; b < NUM_BUCKET; ++b) {
+            seen += bucket[b];
+            if (seen > target) {
+                return 1ULL << (b + 1);
+            }
+        }
+        return max_ns;
+    }
+};
+
+struct Stats
+{
+    unsigned long long ops[NUM_OP] = {};
+    Histogram latency[NUM_OP];
+};
+
+/**
+ * Counts, and if @Timed also times, every queue operation.
+ */
+template <bool Timed>
+struct Meter
+{
+    Stats& stats;
+
+    template <typename F>
+    void run(Op op, F f) {
+        stats.ops[op]++;
+        if (!Timed) {
+            f();
+            return;
+        }
+        Clock::time_point t0 = Clock::now();
+        f();
+        Clock::time_point t1 = Clock::now();
+        stats.latency[op].record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+    }
+};
+
+/**
+ * Both adapters map (id, priority) operations onto a queue. The caller
+ * keeps priorities unique, which PriorityQueue requires of its keys.
+ */
+template <bool Timed>
+struct PriorityQueueAdapter
+{
+    static const char* name() { return "PriorityQueue"; }
+
+    PriorityQueue<unsigned> pq;
+    Meter<Timed> meter;
+
+    PriorityQueueAdapter(unsigned maxSize, Stats& stats) : pq(maxSize), meter{stats} {}
+
+    void insert(unsigned id, unsigned priority) {
+        meter.run(OP_INSERT, [&]() { pq.insert(priority, id); });
+    }
+    void change(unsigned, unsigned oldPriority, unsigned newPriority) {
+        meter.run(OP_CHANGE, [&]() {
+            if (newPriority < oldPriority) {
+                pq.decreaseKey(oldPriority, oldPriority - newPriority);
+            } else {
+                pq.increaseKey(oldPriority, newPriority - oldPriority);
+            }
+        });
+    }
+    void remove(unsigned, unsigned priority) {
+        meter.run(OP_REMOVE, [&]() { pq.remove(priority); });
+    }
+    bool deleteMin(unsigned& id, unsigned& priority) {
+        bool found = false;
+        meter.run(OP_DELETE_MIN, [&]() {
+            const unsigned* key = pq.getMinKey();
+            if (key != nullptr) {
+                priority = *key;
+                id = *(pq.getMinValue());
+                pq.deleteMin();
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    // Build with -DPRIORITY_QUEUE_STATS to see where the time goes.
+    void printStats() const {
+#ifdef PRIORITY_QUEUE_STATS
+        PriorityQueueStats st = pq.stats();
+        unsigned long long up_calls = 0;
+        unsigned long long down_calls = 0;
+        for (unsigned d = 0; d < PriorityQueueStats::NUM_DEPTH_BUCKET; ++d) {
+            up_calls += st.up_depth[d];
+            down_calls += st.down_depth[d];
+        }
+        std::printf("    stats: moves=%llu up=%llu down=%llu map lookups=%llu "
+                    "probes/lookup=%.2f rebuilds=%llu rejected: full=%llu dup=%llu "
+                    "decrease=%llu increase=%llu\n",
+                    st.moves, up_calls, down_calls, st.mapping.lookups,
+                    st.mapping.lookups ? (double) st.mapping.probes / st.mapping.lookups : 0.0,
+                    st.mapping.rebuilds, st.insert_full, st.insert_duplicate,
+                    st.decrease_rejected, st.increase_rejected);
+#endif
+    }
+};
+
+template <bool Timed>
+struct LazyStdAdapter
+{
+    static const char* name() { return "std::priority_queue+lazy"; }
+    static const unsigned NONE = ~0u;
+
+    typedef std::pair<unsigned, unsigned> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > pq;
+    std::vector<unsigned> current;
+    Meter<Timed> meter;
+
+    LazyStdAdapter(unsigned maxSize, Stats& stats) : current(maxSize, NONE), meter{stats} {}
+
+    void insert(unsigned id, unsigned priority) {
+        meter.run(OP_INSERT, [&]() {
+            current[id] = priority;
+            pq.push(Entry(priority, id));
+        });
+    }
+    void change(unsigned id, unsigned, unsigned newPriority) {
+        meter.run(OP_CHANGE, [&]() {
+            current[id] = newPriority;
+            pq.push(Entry(newPriority, id));
+        });
+    }
+    void remove(unsigned id, unsigned) {
+        meter.run(OP_REMOVE, [&]() { current[id] = NONE; });
+    }
+    bool deleteMin(unsigned& id, unsigned& priority) {
+        bool found = false;
+        meter.run(OP_DELETE_MIN, [&]() {
+            while (!pq.empty()) {
+                Entry top = pq.top();
+                pq.pop();
+                if (current[top.second] == top.first) {
+                    current[top.second] = NONE;
+                    priority = top.first;
+                    id = top.second;
+                    found = true;
+                    return;
+                }
+            }
+        });
+        return found;
+    }
+
+    void printStats() const {}
+};
+
+template <bool Timed>
+const unsigned LazyStdAdapter<Timed>::NONE;
+
+/**
+ * Graph in compressed sparse row form; edges are directed.
+ */
+struct Graph
+{
+    unsigned num_node = 0;
+    unsigned width = 0;  // > 0 for grids, used by the A* heuristic
+    std::vector<unsigned> first;
+    std::vector<unsigned> target;
+    std::vector<unsigned> weight;
+};
+
+static Graph fromEdges(unsigned numNode,
+                       const std::vector<std::pair<unsigned, unsigned> >& edges,
+                       std::mt19937& rng, unsigned maxWeight)
+{
+    Graph g;
+    g.num_node = numNode;
+    g.first.assign(numNode + 1, 0);
+    for (const auto& e : edges) {
+        g.first[e.first + 1]++;
+        g.first[e.second + 1]++;
+    }
+    for (unsigned i = 0; i < numNode; ++i) {
+        g.first[i + 1] += g.first[i];
+    }
+    g.target.resize(2 * edges.size());
+    g.weight.resize(2 * edges.size());
+    std::vector<unsigned> fill(g.first.begin(), g.first.end() - 1);
+    for (const auto& e : edges) {
+        unsigned w = 1 + rng() % maxWeight;
+        g.target[fill[e.first]] = e.second;
+        g.weight[fill[e.first]++] = w;
+        g.target[fill[e.second]] = e.first;
+        g.weight[fill[e.second]++] = w;
+    }
+    return g;
+}
+
+/**
+ * Road-like graph: a grid with 4 neighbours per node, small random
+ * weights, and a few grid edges missing.
+ */
+static Graph roadGraph(unsigned side, std::mt19937& rng)
+{
+    std::vector<std::pair<unsigned, unsigned> > edges;
+    for (unsigned y = 0; y < side; ++y) {
+        for (unsigned x = 0; x < side; ++x) {
+            unsigned v = y * side + x;
+            if (x + 1 < side && rng() % 16 != 0) {
+                edges.push_back(std::make_pair(v, v + 1));
+            }
+            if (y + 1 < side && rng() % 16 != 0) {
+                edges.push_back(std::make_pair(v, v + side));
+            }
+        }
+    }
+    Graph g = fromEdges(side * side, edges, rng, 4);
+    g.width = side;
+    return g;
+}
+
+/**
+ * Power-law graph by preferential attachment: each new node links to
+ * @degree earlier nodes, picked with probability proportional to
+ * their degree.
+ */
+static Graph powerLawGraph(unsigned numNode, unsigned degree, std::mt19937& rng)
+{
+    std::vector<std::pair<unsigned, unsigned> > edges;
+    std::vector<unsigned> endpoint;
+    for (unsigned v = 1; v <= degree && v < numNode; ++v) {
+        edges.push_back(std::make_pair(0u, v));
+        endpoint.push_back(0);
+        endpoint.push_back(v);
+    }
+    for (unsigned v = degree + 1; v < numNode; ++v) {
+        for (unsigned i = 0; i < degree; ++i) {
+            unsigned u = endpoint[rng() % endpoint.size()];
+            edges.push_back(std::make_pair(u, v));
+            endpoint.push_back(u);
+            endpoint.push_back(v);
+        }
+    }
+    return fromEdges(numNode, edges, rng, 15);
+}
+
+static unsigned bitsFor(unsigned n)
+{
+    unsigned bits = 0;
+    while ((1ULL << bits) < n) {
+        bits++;
+    }
+    return bits;
+}
+
+// Manhattan distance on a grid with weights >= 1 never overestimates.
+static unsigned heuristic(const Graph& g, unsigned v, unsigned goal)
+{
+    if (g.width == 0) {
+        return 0;
+    }
+    int dx = (int)(v % g.width) - (int)(goal % g.width);
+    int dy = (int)(v / g.width) - (int)(goal / g.width);
+    return (unsigned)(std::abs(dx) + std::abs(dy));
+}
+
+/**
+ * Dijkstra from @source, or A* towards @goal if @goal != num_node.
+ * Priorities are (distance << id_bits) | node, which keeps them unique.
+ *
+ * Returns the largest distance settled, so the caller can check that
+ * it fit into the priority.
+ */
+template <typename Queue>
+unsigned long long shortestPath(const Graph& g, unsigned source, unsigned goal, Queue& q)
+{
+    const unsigned long long INF = ~0ULL;
+    unsigned bits = bitsFor(g.num_node);
+    std::vector<unsigned long long> dist(g.num_node, INF);
+    std::vector<unsigned char> done(g.num_node, 0);
+    unsigned long long max_dist = 0;
+
+    auto priority = [&](unsigned v) {
+        unsigned long long f = dist[v] + (goal < g.num_node ? heuristic(g, v, goal) : 0);
+        return (unsigned)((f << bits) | v);
+    };
+
+    dist[source] = 0;
+    q.insert(source, priority(source));
+    unsigned u;
+    unsigned p;
+    while (q.deleteMin(u, p)) {
+        done[u] = 1;
+        if (dist[u] > max_dist) {
+            max_dist = dist[u];
+        }
+        if (u == goal) {
+            break;
+        }
+        for (unsigned e = g.first[u]; e < g.first[u + 1]; ++e) {
+            unsigned v = g.target[e];
+            unsigned long long nd = dist[u] + g.weight[e];
+            if (done[v] || nd >= dist[v]) {
+                continue;
+            }
+            if (dist[v] == INF) {
+                dist[v] = nd;
+                q.insert(v, priority(v));
+            } else {
+                unsigned old_priority = priority(v);
+                dist[v] = nd;
+                q.change(v, old_priority, priority(v));
+            }
+        }
+    }
+    return max_dist;
+}
+
+/**
+ * Prim's minimum spanning tree from node 0.
+ * Priorities are (edge weight << id_bits) | node.
+ *
+ * Returns the weight of the tree.
+ */
+template <typename Queue>
+unsigned long long prim(const Graph& g, Queue& q)
+{
+    const unsigned NONE = ~0u;
+    unsigned bits = bitsFor(g.num_node);
+    std::vector<unsigned> best(g.num_node, NONE);
+    std::vector<unsigned char> done(g.num_node, 0);
+    unsigned long long total = 0;
+
+    best[0] = 0;
+    q.insert(0, 0);
+    unsigned u;
+    unsigned p;
+    while (q.deleteMin(u, p)) {
+        done[u] = 1;
+        total += best[u];
+        for (unsigned e = g.first[u]; e < g.first[u + 1]; ++e) {
+            unsigned v = g.target[e];
+            unsigned w = g.weight[e];
+            if (done[v] || w >= best[v]) {
+                continue;
+            }
+            if (best[v] == NONE) {
+                best[v] = w;
+                q.insert(v, (w << bits) | v);
+            } else {
+                unsigned old_priority = (best[v] << bits) | v;
+                best[v] = w;
+                q.change(v, old_priority, (w << bits) | v);
+            }
+        }
+    }
+    return total;
+}
+
+/**
+ * One step of a discrete-event simulation trace.
+ */
+struct Event
+{
+    Op op;
+    unsigned entity;
+    unsigned key;
+    unsigned new_key;
+};
+
+/**
+ * Builds a trace in which @numEntity entities each keep one pending
+ * event. The earliest event fires and is rescheduled, while random
+ * other events are postponed (increaseKey) or cancelled and
+ * re-armed (remove + insert). Event times are kept unique.
+ */
+static std::vector<Event> simulationTrace(unsigned numEntity, unsigned numStep, std::mt19937& rng)
+{
+    std::vector<Event> trace;
+    std::map<unsigned, unsigned> pending;  // time -> entity
+    std::vector<unsigned> time_of(numEntity);
+
+    auto freeTime = [&pending](unsigned t) {
+        while (pending.count(t) != 0) {
+            t++;
+        }
+        return t;
+    };
+
+    for (unsigned e = 0; e < numEntity; ++e) {
+        time_of[e] = freeTime(rng() % 100000);
+        pending[time_of[e]] = e;
+        trace.push_back(Event{OP_INSERT, e, time_of[e], 0});
+    }
+
+    for (unsigned step = 0; step < numStep; ++step) {
+        unsigned c = rng() % 8;
+        if (c < 4) {
+            // Fire the earliest event and reschedule its entity.
+            unsigned now = pending.begin()->first;
+            unsigned e = pending.begin()->second;
+            pending.erase(pending.begin());
+            trace.push_back(Event{OP_DELETE_MIN, e, now, 0});
+            time_of[e] = freeTime(now + 1 + rng() % 100000);
+            pending[time_of[e]] = e;
+            trace.push_back(Event{OP_INSERT, e, time_of[e], 0});
+        } else if (c < 7) {
+            unsigned e = rng() % numEntity;
+            unsigned later = freeTime(time_of[e] + 1 + rng() % 50000);
+            pending.erase(time_of[e]);
+            pending[later] = e;
+            trace.push_back(Event{OP_CHANGE, e, time_of[e], later});
+            time_of[e] = later;
+        } else {
+            unsigned e = rng() % numEntity;
+            pending.erase(time_of[e]);
+            trace.push_back(Event{OP_REMOVE, e, time_of[e], 0});
+            time_of[e] = freeTime(time_of[e] + rng() % 200000);
+            pending[time_of[e]] = e;
+            trace.push_back(Event{OP_INSERT, e, time_of[e], 0});
+        }
+    }
+    return trace;
+}
+
+template <typename Queue>
+unsigned long long replay(const std::vector<Event>& trace, Queue& q)
+{
+    unsigned long long checksum = 0;
+    for (const Event& ev : trace) {
+        switch (ev.op) {
+        case OP_INSERT:
+            q.insert(ev.entity, ev.key);
+            break;
+        case OP_CHANGE:
+            q.change(ev.entity, ev.key, ev.new_key);
+            break;
+        case OP_REMOVE:
+            q.remove(ev.entity, ev.key);
+            break;
+        default: {
+            unsigned id;
+            unsigned key;
+            if (q.deleteMin(id, key)) {
+                checksum += key;
+            }
+            break;
+        }
+        }
+    }
+    return checksum;
+}
+
+static void report(const char* workload, const char* structure, const Stats& counted,
+                   double seconds, std::size_t peakBytes, unsigned long long result,
+                   const Stats& timed)
+{
+    unsigned long long total = 0;
+    for (unsigned i = 0; i < NUM_OP; ++i) {
+        total += counted.ops[i];
+    }
+    std::printf("%-22s %-26s %10.3f Mops/s %9.1f MB peak  %llu ops  result %llu\n",
+                workload, structure, total / seconds / 1e6, peakBytes / 1048576.0,
+                total, result);
+    for (unsigned i = 0; i < NUM_OP; ++i) {
+        const Histogram& h = timed.latency[i];
+        if (h.count == 0) {
+            continue;
+        }
+        std::printf("    %-11s n=%-10llu p50<%lluns p99<%lluns p99.9<%lluns max=%lluns |",
+                    op_name[i], h.count, h.quantile(0.5), h.quantile(0.99),
+                    h.quantile(0.999), h.max_ns);
+        for (unsigned b = 0; b < Histogram::NUM_BUCKET; ++b) {
+            if (h.bucket[b] != 0) {
+                std::printf(" %llu:%llu", 1ULL << b, h.bucket[b]);
+            }
+        }
+        std::printf("\n");
+    }
+}
+
+/**
+ * Runs @work once for throughput and memory, then again with every
+ * operation timed. @work is generic so it can take both passes' queues.
+ */
+template <template <bool> class Queue, typename Work>
+void measure(const char* workload, unsigned maxSize, Work work)
+{
+    Stats counted;
+    std::size_t base = heap_live;
+    heap_peak = heap_live;
+    Clock::time_point t0 = Clock::now();
+    unsigned long long result;
+    {
+        Queue<false> q(maxSize, counted);
+        result = work(q);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    std::size_t peak = heap_peak - base;
+
+    Stats timed;
+    {
+        Queue<true> q(maxSize, timed);
+        work(q);
+        report(workload, Queue<false>::name(), counted, seconds, peak, result, timed);
+        q.printStats();
+    }
+}
+
+template <template <bool> class Queue>
+void runAll(const Graph& road, const Graph& power, const std::vector<Event>& trace,
+            unsigned numEntity)
+{
+    unsigned goal = road.num_node - 1;
+    measure<Queue>("dijkstra/road", road.num_node, [&](auto& q) {
+        return shortestPath(road, 0, road.num_node, q);
+    });
+    measure<Queue>("dijkstra/power-law", power.num_node, [&](auto& q) {
+        return shortestPath(power, 0, power.num_node, q);
+    });
+    measure<Queue>("astar/road", road.num_node, [&](auto& q) {
+        return shortestPath(road, 0, goal, q);
+    });
+    measure<Queue>("prim/road", road.num_node, [&](auto& q) {
+        return prim(road, q);
+    });
+    measure<Queue>("prim/power-law", power.num_node, [&](auto& q) {
+        return prim(power, q);
+    });
+    measure<Queue>("des/trace", numEntity, [&](auto& q) {
+        return replay(trace, q);
+    });
+}
+
+int main(int argc, char** argv)
+{
+    // Node count is 2^scale. Priorities pack the node id into the low
+    // bits of a 32-bit key, so scale is capped to leave room for distances.
+    unsigned scale = argc > 1 ? (unsigned) std::atoi(argv[1]) : 19;
+    if (scale < 8 || scale > 22) {
+        std::fprintf(stderr, "usage: %s [scale 8..22]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(12345);
+    unsigned side = 1u << (scale / 2);
+    Graph road = roadGraph(side, rng);
+    Graph power = powerLawGraph(1u << scale, 4, rng);
+    unsigned num_entity = 1u << (scale - 3);
+    std::vector<Event> trace = simulationTrace(num_entity, 4u << scale, rng);
+
+    std::printf("road: %u nodes %zu edges, power-law: %u nodes %zu edges, "
+                "des: %u entities %zu events\n",
+                road.num_node, road.target.size(), power.num_node, power.target.size(),
+                num_entity, trace.size());
+
+    // The lazy version works on 64-bit distances, so use it to check
+    // that every distance fits next to the node id.
+    {
+        Stats unused;
+        LazyStdAdapter<false> q(road.num_node, unused);
+        unsigned long long road_max = shortestPath(road, 0, road.num_node, q);
+        LazyStdAdapter<false> r(power.num_node, unused);
+        unsigned long long power_max = shortestPath(power, 0, power.num_node, r);
+        if (road_max >= (1ULL << (32 - bitsFor(road.num_node))) ||
+            power_max >= (1ULL << (32 - bitsFor(power.num_node)))) {
+            std::fprintf(stderr, "scale %u too large: distances do not fit in a key\n", scale);
+            return 1;
+        }
+    }
+
+    runAll<PriorityQueueAdapter>(road, power, trace, num_entity);
+    runAll<LazyStdAdapter>(road, power, trace, num_entity);
+}
+
+/* Run code using following commands
+ * g++ -Wall -Werror -O2 -std=c++14 bench_priority_queue.cpp -o bench_priority_queue
+ * ./bench_priority_queue [scale]
+ * Add -DPRIORITY_QUEUE_STATS to also print PriorityQueue counters.
+ */
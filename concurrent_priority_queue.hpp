@@ -0,0 +1,277 @@
+#ifndef CONCURRENT_PRIORITY_QUEUE_HPP
+#define CONCURRENT_PRIORITY_QUEUE_HPP
+#include "priority_queue.hpp"
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+/**
+ * Implementation of a relaxed concurrent priority queue
+ * (MultiQueue) built from c * P sequential PriorityQueues,
+ * each guarded by its own lock.
+ *
+ * insert() goes to a randomly chosen internal queue.
+ * deleteMin() samples a few internal queues, and removes the
+ * smaller of their roots. The removed element is therefore
+ * close to, but not always, the global minimum. More internal
+ * queues per thread means less contention and a looser order.
+ * More samples per deleteMin() means a tighter order.
+ *
+ * In strict mode deleteMin() locks every internal queue and
+ * always removes the global minimum.
+ *
+ * Keys are only checked for uniqueness inside one internal
+ * queue, so the caller has to keep them unique.
+ *
+ * There is no shared element count: each internal queue keeps its
+ * own, so threads only ever touch the lanes they picked.
+ */
+
+template <typename ValueType>
+struct Lane_queue
+{
+    std::mutex lock;
+    // Root key of @queue, or ULLONG_MAX if it is empty. Read without
+    // the lock to pick a queue; only written while holding it.
+    std::atomic<unsigned long long> min_key{ULLONG_MAX};
+    // Number of elements in @queue, kept the same way as @min_key.
+    std::atomic<unsigned> num_element{0};
+    PriorityQueue<ValueType>* queue = nullptr;
+    // Keeps the fields above of two neighbouring lanes on different
+    // cache lines.
+    char padding[64];
+};
+
+template <typename ValueType>
+class ConcurrentPriorityQueue
+{
+public:
+    /**
+     * Creates a priority queue that can have at least @maxSize elements,
+     * meant to be shared by @numThreads threads. @maxSize is rounded up
+     * to a multiple of the number of internal queues; maxSize() returns
+     * the result.
+     *
+     * @queuesPerThread is the c in c * P internal queues, and
+     * @choices is how many of them deleteMin() compares.
+     * If @strict is true, deleteMin() always removes the global minimum.
+     *
+     * Throws std::runtime_error if any size argument is 0.
+     */
+    ConcurrentPriorityQueue(unsigned maxSize, unsigned numThreads,
+                            unsigned queuesPerThread = 2, unsigned choices = 2,
+                            bool strict = false) {
+        if (maxSize == 0) {
+            throw std::runtime_error("maxSize cannot be 0.");
+        }
+        if (numThreads == 0 || queuesPerThread == 0 || choices == 0) {
+            throw std::runtime_error("Number of queues cannot be 0.");
+        }
+
+        num_lane = numThreads * queuesPerThread;
+        num_choice = choices;
+        is_strict = strict;
+        lane_size = (maxSize + num_lane - 1) / num_lane;
+
+        lane = new Lane_queue<ValueType>[num_lane];
+        for (unsigned i = 0; i < num_lane; ++i) {
+            lane[i].queue = new PriorityQueue<ValueType>(lane_size);
+        }
+    }
+
+    ~ConcurrentPriorityQueue() {
+        for (unsigned i = 0; i < num_lane; ++i) {
+            delete lane[i].queue;
+        }
+        delete[] lane;
+    }
+
+    ConcurrentPriorityQueue(const ConcurrentPriorityQueue& rhs) = delete;
+    ConcurrentPriorityQueue& operator=(const ConcurrentPriorityQueue& rhs) = delete;
+
+    /**
+     * numElements() adds up the sizes of all internal queues, and
+     * may be out of date by the time it returns if other threads
+     * are using the queue.
+     */
+    unsigned numElements() const {
+        unsigned total = 0;
+        for (unsigned i = 0; i < num_lane; ++i) {
+            total += lane[i].num_element.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+    unsigned maxSize() const {
+        return num_lane * lane_size;
+    }
+    unsigned numQueues() const {
+        return num_lane;
+    }
+
+    /**
+     * Inserts a key-value pair mapping @key to @value into
+     * the priority queue.
+     *
+     * Returns true if success.
+     *
+     * Returns false if every internal queue is full, or if @key is already
+     * in the internal queue that was picked.
+     */
+    bool insert(unsigned key, const ValueType& value) {
+        // Random internal queues first, skipping any that are busy.
+        for (unsigned attempt = 0; attempt < num_lane; ++attempt) {
+            Lane_queue<ValueType>& l = lane[randomLane()];
+            if (l.num_element.load(std::memory_order_relaxed) == lane_size ||
+                !l.lock.try_lock()) {
+                continue;
+            }
+            if (l.queue->numElements() == lane_size) {
+                l.lock.unlock();
+                continue;
+            }
+
+            bool inserted = insertLocked(l, key, value);
+            l.lock.unlock();
+            return inserted;
+        }
+
+        // Most internal queues are full or busy. Visit all of them, waiting
+        // for their locks, so that false really means there was no room.
+        unsigned start = randomLane();
+        for (unsigned i = 0; i < num_lane; ++i) {
+            Lane_queue<ValueType>& l = lane[(start + i) % num_lane];
+            if (l.num_element.load(std::memory_order_relaxed) == lane_size) {
+                continue;
+            }
+            std::lock_guard<std::mutex> guard(l.lock);
+            if (l.queue->numElements() < lane_size) {
+                return insertLocked(l, key, value);
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Removes a smallest (or, unless strict, nearly smallest) element
+     * and copies it to @key and @value.
+     *
+     * Returns true if success.
+     * Returns false if priority queue is empty, i.e. nothing to delete.
+     */
+    bool deleteMin(unsigned& key, ValueType& value) {
+        if (is_strict) {
+            return deleteMinStrict(key, value);
+        }
+
+        while (true) {
+            unsigned best = randomLane();
+            unsigned long long best_key = lane[best].min_key.load(std::memory_order_relaxed);
+            for (unsigned i = 1; i < num_choice; ++i) {
+                unsigned candidate = randomLane();
+                unsigned long long candidate_key =
+                    lane[candidate].min_key.load(std::memory_order_relaxed);
+                if (candidate_key < best_key) {
+                    best = candidate;
+                    best_key = candidate_key;
+                }
+            }
+
+            // With few elements left, random picks mostly hit empty queues.
+            if (best_key == ULLONG_MAX) {
+                for (unsigned i = 0; i < num_lane; ++i) {
+                    if (lane[i].min_key.load(std::memory_order_relaxed) != ULLONG_MAX) {
+                        best = i;
+                        best_key = 0;
+                        break;
+                    }
+                }
+                if (best_key == ULLONG_MAX) {
+                    return false;
+                }
+            }
+
+            Lane_queue<ValueType>& l = lane[best];
+            if (!l.lock.try_lock()) {
+                continue;
+            }
+            if (l.queue->numElements() == 0) {
+                l.lock.unlock();
+                continue;
+            }
+
+            popLocked(l, key, value);
+            l.lock.unlock();
+            return true;
+        }
+    }
+
+private:
+    bool deleteMinStrict(unsigned& key, ValueType& value) {
+        // Always lock in the same order so that two strict deleteMin()
+        // calls cannot deadlock.
+        for (unsigned i = 0; i < num_lane; ++i) {
+            lane[i].lock.lock();
+        }
+
+        unsigned best = num_lane;
+        for (unsigned i = 0; i < num_lane; ++i) {
+            const unsigned* min = lane[i].queue->getMinKey();
+            if (min != nullptr &&
+                (best == num_lane || *min < *(lane[best].queue->getMinKey()))) {
+                best = i;
+            }
+        }
+
+        if (best != num_lane) {
+            popLocked(lane[best], key, value);
+        }
+
+        for (unsigned i = num_lane; i > 0; --i) {
+            lane[i - 1].lock.unlock();
+        }
+        return best != num_lane;
+    }
+
+    bool insertLocked(Lane_queue<ValueType>& l, unsigned key, const ValueType& value) {
+        if (!l.queue->insert(key, value)) {
+            return false;
+        }
+        l.min_key.store(*(l.queue->getMinKey()), std::memory_order_relaxed);
+        l.num_element.store(l.queue->numElements(), std::memory_order_relaxed);
+        return true;
+    }
+
+    void popLocked(Lane_queue<ValueType>& l, unsigned& key, ValueType& value) {
+        key = *(l.queue->getMinKey());
+        value = *(l.queue->getMinValue());
+        l.queue->deleteMin();
+
+        const unsigned* min = l.queue->getMinKey();
+        l.min_key.store(min == nullptr ? ULLONG_MAX : *min, std::memory_order_relaxed);
+        l.num_element.store(l.queue->numElements(), std::memory_order_relaxed);
+    }
+
+    /**
+     * Picks an internal queue uniformly at random, using a per-thread
+     * xorshift generator so that threads never share random state.
+     */
+    unsigned randomLane() const {
+        static thread_local unsigned long long state =
+            (std::hash<std::thread::id>()(std::this_thread::get_id()) | 1) * 0x9E3779B97F4A7C15ULL;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (unsigned)(((state >> 32) * num_lane) >> 32);
+    }
+
+    Lane_queue<ValueType>* lane;
+    unsigned num_lane;
+    unsigned num_choice;
+    unsigned lane_size;
+    bool is_strict;
+};
+
+#endif  // CONCURRENT_PRIORITY_QUEUE_HPP
@@ -0,0 +1,66 @@
+#include "concurrent_priority_queue.hpp"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+int main()
+{
+    std::cout << std::boolalpha;
+    // Strict mode behaves like a single PriorityQueue.
+    ConcurrentPriorityQueue<std::string> q1(10, 2, 2, 2, true);
+    std::cout << q1.numQueues() << '\n';
+    std::cout << q1.insert(10, "AA") << '\n';
+    q1.insert(13, "BB");
+    q1.insert(8, "CC");
+    q1.insert(5, "DD");
+    unsigned key;
+    std::string value;
+    while (q1.deleteMin(key, value)) {
+        std::cout << key << ' ' << value << '\n';
+    }
+    std::cout << q1.deleteMin(key, value) << '\n';
+
+    // Relaxed mode, shared by several threads.
+    std::cout << "=======\n";
+    const unsigned num_threads = 4;
+    const unsigned per_thread = 10000;
+    ConcurrentPriorityQueue<unsigned> q2(num_threads * per_thread, num_threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < num_threads; ++t) {
+        workers.emplace_back([&q2, t]() {
+            for (unsigned i = 0; i < per_thread; ++i) {
+                q2.insert(i * num_threads + t, t);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    std::cout << q2.numElements() << '\n';
+    std::cout << q2.insert(123456789, 0) << '\n';  // full
+
+    std::vector<unsigned> removed(num_threads, 0);
+    workers.clear();
+    for (unsigned t = 0; t < num_threads; ++t) {
+        workers.emplace_back([&q2, &removed, t]() {
+            unsigned k;
+            unsigned v;
+            while (q2.deleteMin(k, v)) {
+                removed[t]++;
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    unsigned total = 0;
+    for (unsigned r : removed) {
+        total += r;
+    }
+    std::cout << total << ' ' << q2.numElements() << '\n';
+}
+
+/* Run code using following commands
+ * g++ -Wall -Werror -g -std=c++14 -pthread demo_concurrent_priority_queue.cpp -o demo_concurrent_priority_queue
+ * ./demo_concurrent_priority_queue
+ */
@@ -0,0 +1,36 @@
+#include "expiring_cache.hpp"
+#include <iostream>
+#include <string>
+int main()
+{
+    std::cout << std::boolalpha;
+    // At most 3 entries, each living 100 ticks.
+    ExpiringCache<std::string> cache(3, 100);
+    cache.put(1, "AA", 0);
+    cache.put(2, "BB", 10);
+    cache.put(3, "CC", 20);
+    std::cout << *(cache.get(1, 30)) << '\n'; // AA, now most recently used
+
+    cache.put(4, "DD", 40); // evicts 2
+    std::cout << (cache.get(2, 40) == nullptr) << '\n'; // true
+    std::cout << cache.numEntries() << ' ' << cache.numEvictions() << '\n'; // 3 1
+
+    std::cout << "-----\n";
+    std::cout << (cache.get(1, 100) == nullptr) << '\n'; // true, due at 100
+    cache.put(3, "CC2", 100); // expires at 200 now
+    std::cout << cache.expire(150) << '\n'; // 1, key 4
+    std::cout << *(cache.get(3, 150)) << '\n'; // CC2
+    std::cout << cache.remove(3) << '\n'; // true
+    std::cout << cache.remove(3) << '\n'; // false
+
+    std::cout << "-----\n";
+    cache.put(5, "EE", 150, 10); // shorter ttl
+    cache.put(6, "FF", 150);
+    std::cout << cache.expire(160) << '\n'; // 1
+    std::cout << cache.numEntries() << '\n'; // 1
+}
+
+/* Run code using following commands
+ * g++ -Wall -Werror -g -std=c++14 demo_expiring_cache.cpp -o demo_expiring_cache
+ * ./demo_expiring_cache
+ */
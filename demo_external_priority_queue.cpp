@@ -0,0 +1,28 @@
+#include "external_priority_queue.hpp"
+#include <iostream>
+int main()
+{
+    std::cout << std::boolalpha;
+    // Insertion heap of 4 elements, runs read 2 at a time, and
+    // 3 runs on one level are merged into one.
+    ExternalPriorityQueue<int> p(".", 4, 2, 3);
+    for (unsigned key = 20; key > 0; --key) {
+        p.insert(key * 7 % 23, (int) key);
+    }
+    std::cout << p.numElements() << ' ' << p.numRuns() << '\n'; // 20 2
+    std::cout << p.insert(21, 0) << '\n'; // false, still in memory
+
+    std::cout << "-----\n";
+    while (p.numElements() > 0) {
+        std::cout << '(' << *(p.getMinKey()) << ',' << *(p.getMinValue()) << ") ";
+        p.deleteMin();
+    }
+    std::cout << '\n';
+    std::cout << p.numRuns() << '\n'; // 0
+    std::cout << p.deleteMin() << '\n'; // false
+}
+
+/* Run code using following commands
+ * g++ -Wall -Werror -g -std=c++14 demo_external_priority_queue.cpp -o demo_external_priority_queue
+ * ./demo_external_priority_queue
+ */
@@ -1,5 +1,6 @@
 #include "hash_table.hpp"
 #include <iostream>
+#include <utility>
 
 static void foo(const HashTable<std::string>& ht)
 {
@@ -93,6 +94,48 @@ int main()
     b.insert(3, "EE");
     HashTable<std::string> c = a + b;
     std::cout << c;
+    // Inline slots.
+    std::cout << "=== inline slots ===\n";
+    HashTable<std::string> d(7);
+    d.insert(1, "AA");
+    d.insert(2, "BB");
+    d.insert(3, "CC");
+    std::cout << d.tableSize() << ' ' << d.numElements() << ' ' << d.isInline() << '\n';
+    for (unsigned key = 4; key <= 8; ++key) {
+        d.insert(key, "DD");  // grows to 17 slots, still inline
+    }
+    std::cout << d.tableSize() << ' ' << d.numElements() << ' ' << d.isInline() << '\n';
+    d.insert(9, "EE");  // 37 slots do not fit, so it moves to the heap
+    std::cout << d.tableSize() << ' ' << d.numElements() << ' ' << d.isInline() << '\n';
+    HashTable<std::string, 0> e(7);  // no inline slots at all
+    std::cout << e.isInline() << '\n';
+    std::cout << "---\n";
+    HashTable<std::string> f(7);
+    f.insert(10, "FF");
+    f.insert(12, "GG");
+    HashTable<std::string> g(f);
+    HashTable<std::string> h(std::move(f));
+    std::cout << g.isInline() << ' ' << h.isInline() << ' ' << (g == h) << '\n';
+    std::cout << h;
+    g = d;
+    std::cout << g.tableSize() << ' ' << g.isInline() << ' ' << (g == d) << '\n';
+    // Fingerprints.
+    std::cout << "=== fingerprint ===\n";
+    HashTable<std::string> p(7);
+    HashTable<std::string> q(31);
+    p.insert(1, "AA");
+    p.insert(2, "BB");
+    q.insert(2, "BB");
+    q.insert(1, "AA");
+    std::cout << (p.fingerprint() == q.fingerprint()) << '\n';
+    q.update(2, "CC");
+    std::cout << (p.fingerprint() == q.fingerprint()) << ' ' << (p == q) << '\n';
+    *q.get(2) = "BB";  // written through get(), so q's fingerprint is stale
+    std::cout << q.isFingerprintCurrent() << ' ' << (p == q) << '\n';
+    q.fingerprint();  // rescans q once
+    std::cout << q.isFingerprintCurrent() << ' ' << (p.fingerprint() == q.fingerprint()) << '\n';
+    const HashTable<std::string>& r = q;
+    std::cout << *r.get(2) << ' ' << q.isFingerprintCurrent() << '\n';
 }
 
 /* Run code using following commands
@@ -1,5 +1,6 @@
 #include "priority_queue.hpp"
 #include <iostream>
+#include <sstream>
 int main()
 {
     std::cout << std::boolalpha;
@@ -75,9 +76,65 @@ int main()
     std::cout << p3.increaseKey(35, 4) << '\n'; // false
     std::cout << p3.increaseKey(3, 4) << '\n'; // true
     std::cout << p3;
+
+    std::cout << "---Top-k---\n";
+    PriorityQueue<std::string> p4(3);
+    std::cout << p4.offer(40, "AA") << '\n'; // true
+    std::cout << p4.offer(10, "BB") << '\n'; // true
+    std::cout << p4.offer(30, "CC") << '\n'; // true
+    std::cout << p4.offer(5, "DD") << '\n'; // false
+    std::cout << p4.offer(20, "EE") << '\n'; // true
+    std::cout << p4.offer(40, "FF") << '\n'; // false
+    std::cout << p4;
+    std::cout << p4.drainSorted([](unsigned key, const std::string& value) {
+        std::cout << key << ' ' << value << '\n';
+    }) << '\n'; // 3
+    std::cout << p4.numElements() << '\n'; // 0
+    std::cout << p4.offer(40, "AA") << '\n'; // true
+
+    std::cout << "---Merge---\n";
+    PriorityQueue<std::string> p5(3);
+    p5.insert(7, "AA");
+    p5.insert(2, "BB");
+    PriorityQueue<std::string> p6(4);
+    p6.insert(5, "CC");
+    p6.insert(1, "DD");
+    p6.insert(9, "EE");
+    PriorityQueue<std::string> p7(2);
+    p7.insert(5, "FF");
+    std::cout << p5.merge(std::move(p7)) << '\n'; // true
+    std::cout << p5.merge(std::move(p6)) << '\n'; // false, 5 in both
+    p5.remove(5);
+    std::cout << p5.merge(std::move(p6)) << '\n'; // true
+    std::cout << p5.numElements() << ' ' << p5.maxSize() << '\n'; // 5 7
+    std::cout << p6.numElements() << '\n'; // 0
+    std::cout << p5;
+
+    std::cout << "---Save/Load---\n";
+    std::stringstream saved;
+    p3.save(saved);
+    PriorityQueue<int> p8 = PriorityQueue<int>::load(saved);
+    std::cout << p8.numElements() << ' ' << p8.maxSize() << '\n'; // 4 15
+    std::cout << p8;
+    std::cout << p8.insert(3, 30) << '\n'; // false
+    std::cout << *(p8.get(9)) << '\n'; // 20
+    std::stringstream garbage("not a queue");
+    try {
+        PriorityQueue<int>::load(garbage);
+    } catch (const std::runtime_error& e) {
+        std::cout << e.what() << '\n';
+    }
+
+    std::cout << "---Build---\n";
+    unsigned keys[] = {9, 4, 7, 1, 8, 2, 6, 3, 5};
+    int values[] = {90, 40, 70, 10, 80, 20, 60, 30, 50};
+    PriorityQueue<int> p9 = PriorityQueue<int>::build(keys, values, 9, 12, 2);
+    std::cout << p9;
+    std::cout << p9.verifyHeap(2) << '\n'; // true
+    std::cout << *(p9.getMinValue()) << '\n'; // 10
 }
 
 /* Run code using following commands
- * g++ -Wall -Werror -g -std=c++14 demo_hash_table.cpp -o demo_hash_table
- * ./demo_hash_table
+ * g++ -Wall -Werror -g -std=c++14 -pthread demo_priority_queue.cpp -o demo_priority_queue
+ * ./demo_priority_queue
  */
@@ -0,0 +1,45 @@
+#include "timer_wheel.hpp"
+#include <iostream>
+#include <string>
+int main()
+{
+    std::cout << std::boolalpha;
+    TimerWheel<std::string> tw(10);
+    unsigned a = tw.schedule(5, "AA");
+    unsigned b = tw.schedule(300, "BB");
+    unsigned c = tw.schedule(70000, "CC");
+    unsigned d = tw.schedule(20000000, "DD");  // beyond the wheel
+    std::cout << tw.numTimers() << '\n';
+    std::cout << *(tw.get(b)) << '\n';
+
+    auto print = [&tw](unsigned id, const std::string& value) {
+        std::cout << "tick " << tw.now() << ": " << id << ' ' << value << '\n';
+    };
+
+    std::cout << "-----\n";
+    std::cout << tw.advance(10, print) << '\n';
+    std::cout << tw.cancel(a) << '\n';  // already expired
+    std::cout << tw.cancel(b) << '\n';
+    std::cout << tw.reschedule(c, 20) << '\n';
+    std::cout << tw.advance(100, print) << '\n';
+    std::cout << tw.numTimers() << '\n';
+
+    std::cout << "-----\n";
+    std::cout << tw.reschedule(d, 40000000) << '\n';
+    std::cout << tw.advance(30000000, print) << '\n';
+    std::cout << tw.advance(40000000, print) << '\n';
+    std::cout << tw.numTimers() << '\n';
+
+    // Timers due on the same tick expire together.
+    std::cout << "-----\n";
+    for (unsigned i = 0; i < 10; ++i) {
+        tw.schedule(40000500, "EE");
+    }
+    std::cout << tw.schedule(40000500, "FF") << '\n';  // full
+    std::cout << tw.advance(40000500, [](unsigned, const std::string&) {}) << '\n';
+}
+
+/* Run code using following commands
+ * g++ -Wall -Werror -g -std=c++14 demo_timer_wheel.cpp -o demo_timer_wheel
+ * ./demo_timer_wheel
+ */
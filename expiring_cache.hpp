@@ -0,0 +1,266 @@
+#ifndef EXPIRING_CACHE_HPP
+#define EXPIRING_CACHE_HPP
+#include "hash_table.hpp"
+#include "timer_wheel.hpp"
+#include <climits>
+#include <stdexcept>
+
+/**
+ * Implementation of a bounded cache that maps unsigned keys
+ * to instances of ValueType, with both a capacity and a
+ * time-to-live limit.
+ *
+ * Entries sit in a fixed pool. One HashTable maps each key to its
+ * entry, and the entry holds everything else: the value, its place
+ * in the LRU list and the id of its expiry timer. A hit therefore
+ * costs one hash lookup plus a constant-time move to the front of
+ * the list.
+ *
+ * Once the cache is full, put() of a new key evicts the least
+ * recently used entry. Expiry timers live in a TimerWheel, so
+ * expire() removes everything that is due in one batch, and get()
+ * treats an entry that is due as missing even before that.
+ *
+ * Time is counted in ticks, as in TimerWheel.
+ */
+
+template <typename ValueType>
+struct Entry_cache
+{
+    unsigned key;
+    ValueType value;
+    unsigned deadline;
+    unsigned timer;
+    // Neighbours in the LRU list; @next also links the free list.
+    unsigned prev;
+    unsigned next;
+};
+
+template <typename ValueType>
+class ExpiringCache
+{
+public:
+    /**
+     * Creates a cache that holds at most @capacity entries, each of
+     * which expires @ttl ticks after it was last put().
+     *
+     * Throws std::runtime_error if @capacity or @ttl is 0.
+     */
+    ExpiringCache(unsigned capacity, unsigned ttl, unsigned now = 0)
+        : index(tableSizeFor(capacity)), expiry(capacity == 0 ? 1 : capacity, now) {
+        if (capacity == 0) {
+            throw std::runtime_error("capacity cannot be 0.");
+        }
+        if (ttl == 0) {
+            throw std::runtime_error("ttl cannot be 0.");
+        }
+
+        size_max = capacity;
+        time_to_live = ttl;
+        entry = new Entry_cache<ValueType>[capacity];
+
+        for (unsigned i = 0; i < capacity; ++i) {
+            entry[i].next = i + 1 < capacity ? i + 1 : NIL;
+        }
+        free_head = 0;
+    }
+
+    ~ExpiringCache() {
+        delete[] entry;
+    }
+
+    ExpiringCache(const ExpiringCache& rhs) = delete;
+    ExpiringCache& operator=(const ExpiringCache& rhs) = delete;
+
+    /**
+     * All of these must run in constant time.
+     * numEntries() may count entries that are due but not yet expire()d.
+     */
+    unsigned numEntries() const {
+        return num_entry;
+    }
+    unsigned capacity() const {
+        return size_max;
+    }
+    unsigned ttl() const {
+        return time_to_live;
+    }
+
+    /**
+     * Maps @key to @value, expiring @ttl() ticks after @now.
+     * If @key is already cached, its value is replaced and its
+     * expiry pushed back.
+     *
+     * If the cache is full, the least recently used entry is evicted
+     * to make room.
+     */
+    void put(unsigned key, const ValueType& value, unsigned now) {
+        put(key, value, now, time_to_live);
+    }
+
+    /**
+     * Same as above, but the entry expires @ttl ticks after @now.
+     */
+    void put(unsigned key, const ValueType& value, unsigned now, unsigned ttl) {
+        unsigned deadline = now + ttl;
+        unsigned* found = index.get(key);
+        if (found != nullptr) {
+            Entry_cache<ValueType>& e = entry[*found];
+            e.value = value;
+            e.deadline = deadline;
+            expiry.reschedule(e.timer, deadline);
+            touch(*found);
+            return;
+        }
+
+        if (free_head == NIL) {
+            num_eviction++;
+            erase(lru_tail, true);
+        }
+
+        unsigned i = free_head;
+        free_head = entry[i].next;
+        entry[i].key = key;
+        entry[i].value = value;
+        entry[i].deadline = deadline;
+        entry[i].timer = expiry.schedule(deadline, i);
+        index.insert(key, i);
+        pushFront(i);
+        num_entry++;
+    }
+
+    /**
+     * Returns address of the value cached for @key and marks it as
+     * the most recently used entry.
+     *
+     * Returns null pointer if @key is not cached, or if its entry is
+     * due at @now, in which case the entry is removed right away.
+     */
+    ValueType* get(unsigned key, unsigned now) {
+        unsigned* found = index.get(key);
+        if (found == nullptr) {
+            return nullptr;
+        }
+
+        unsigned i = *found;
+        if ((int)(now - entry[i].deadline) >= 0) {
+            erase(i, true);
+            return nullptr;
+        }
+        touch(i);
+        return &entry[i].value;
+    }
+
+    /**
+     * Returns true if success.
+     * Returns false if @key is not cached.
+     */
+    bool remove(unsigned key) {
+        unsigned* found = index.get(key);
+        if (found == nullptr) {
+            return false;
+        }
+        erase(*found, true);
+        return true;
+    }
+
+    /**
+     * Removes every entry that is due at @now.
+     * @now must not go back in time between calls.
+     *
+     * Returns the number of entries removed.
+     */
+    unsigned expire(unsigned now) {
+        // The wheel releases each timer itself once the callback returns.
+        return expiry.advance(now, [this](unsigned, unsigned i) {
+            erase(i, false);
+        });
+    }
+
+    /**
+     * Returns the number of entries evicted for capacity so far.
+     */
+    unsigned long long numEvictions() const {
+        return num_eviction;
+    }
+
+private:
+    static const unsigned NIL = UINT_MAX;
+
+    /**
+     * The index never holds more than @capacity keys, so a prime of
+     * at least twice that keeps it below the load that forces a rehash.
+     */
+    static unsigned tableSizeFor(unsigned capacity) {
+        unsigned prime_num = capacity * 2 + 1;
+        while (true) {
+            bool flag_prime = true;
+            for (unsigned i = 2; i * i <= prime_num; ++i) {
+                if (prime_num % i == 0) {
+                    flag_prime = false;
+                    break;
+                }
+            }
+            if (flag_prime) {
+                return prime_num;
+            }
+            prime_num++;
+        }
+    }
+
+    void erase(unsigned i, bool cancelTimer) {
+        if (cancelTimer) {
+            expiry.cancel(entry[i].timer);
+        }
+        index.remove(entry[i].key);
+        unlink(i);
+        entry[i].next = free_head;
+        free_head = i;
+        num_entry--;
+    }
+
+    void touch(unsigned i) {
+        if (lru_head == i) {
+            return;
+        }
+        unlink(i);
+        pushFront(i);
+    }
+
+    void pushFront(unsigned i) {
+        entry[i].prev = NIL;
+        entry[i].next = lru_head;
+        if (lru_head != NIL) {
+            entry[lru_head].prev = i;
+        } else {
+            lru_tail = i;
+        }
+        lru_head = i;
+    }
+
+    void unlink(unsigned i) {
+        if (entry[i].prev != NIL) {
+            entry[entry[i].prev].next = entry[i].next;
+        } else {
+            lru_head = entry[i].next;
+        }
+        if (entry[i].next != NIL) {
+            entry[entry[i].next].prev = entry[i].prev;
+        } else {
+            lru_tail = entry[i].prev;
+        }
+    }
+
+    struct Entry_cache<ValueType> *entry;
+    HashTable<unsigned> index;
+    TimerWheel<unsigned> expiry;
+    unsigned lru_head = NIL;
+    unsigned lru_tail = NIL;
+    unsigned free_head;
+    unsigned num_entry = 0;
+    unsigned long long num_eviction = 0;
+    unsigned size_max;
+    unsigned time_to_live;
+};
+
+#endif  // EXPIRING_CACHE_HPP
@@ -0,0 +1,521 @@
+#ifndef EXTERNAL_PRIORITY_QUEUE_HPP
+#define EXTERNAL_PRIORITY_QUEUE_HPP
+#include "priority_queue.hpp"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Implementation of an external-memory priority queue that
+ * holds more elements than fit in memory, each mapping a key
+ * to an instance of ValueType.
+ *
+ * New elements go into an in-memory PriorityQueue, the insertion
+ * heap. When it is full, its contents are written out in key order
+ * as a sorted run, a file in a directory of its own that the queue
+ * creates for itself.
+ * The fronts of the runs play in a loser tree, so deleteMin() only
+ * compares its winner with the insertion heap, and replays one path
+ * of the tree after taking from a run. Each run is read through a
+ * buffer, so the disk only sees large sequential reads and writes.
+ *
+ * Runs are kept in levels. A spilled run starts on level 0, and once
+ * a level holds @maxRuns runs they are merged into one run on the next
+ * level, which bounds the number of runs in the tree.
+ *
+ * A spill or merge that fails to write or read throws
+ * std::runtime_error and leaves the queue as it was before: no element
+ * is lost and no run file is left behind. A spill that succeeds but
+ * whose merge fails keeps the unmerged runs and retries the merge on
+ * the next spill.
+ *
+ * Keys are only checked for uniqueness inside the insertion heap, so
+ * the caller has to keep them unique. ValueType must be trivially
+ * copyable, as values are written to disk byte for byte.
+ */
+
+template <typename ValueType>
+struct Record_run
+{
+    unsigned key;
+    ValueType value;
+};
+
+template <typename ValueType>
+struct Run_file
+{
+    std::string path;
+    std::ifstream in;
+    std::vector<Record_run<ValueType>> buffer;
+    // Next record in @buffer, and number of records still on disk.
+    unsigned head = 0;
+    unsigned long long remaining = 0;
+    unsigned level = 0;
+};
+
+template <typename ValueType>
+class ExternalPriorityQueue
+{
+    static_assert(std::is_trivially_copyable<ValueType>::value,
+                  "ExternalPriorityQueue needs a trivially copyable ValueType");
+
+public:
+    /**
+     * Creates an external priority queue that writes its runs into a
+     * new, uniquely named directory inside @directory, which must
+     * already exist. The new directory is removed again on destruction,
+     * so several queues, in one process or several, can share @directory.
+     *
+     * @memorySize is the number of elements the insertion heap holds,
+     * @bufferSize the number of elements read or written at a time, and
+     * @maxRuns the number of runs on one level before they are merged.
+     *
+     * Throws std::runtime_error if any size argument is 0, @maxRuns is 1,
+     * or the run directory cannot be created.
+     */
+    ExternalPriorityQueue(const std::string& directory, unsigned memorySize,
+                          unsigned bufferSize = 4096, unsigned maxRuns = 16)
+        : heap(memorySize) {
+        if (bufferSize == 0) {
+            throw std::runtime_error("bufferSize cannot be 0.");
+        }
+        if (maxRuns < 2) {
+            throw std::runtime_error("maxRuns must be at least 2.");
+        }
+
+        std::string pattern = directory + "/pq_runs_XXXXXX";
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        if (mkdtemp(name.data()) == nullptr) {
+            throw std::runtime_error("Failed to create run directory.");
+        }
+        run_directory = name.data();
+        path_prefix = run_directory + "/run_";
+        size_buffer = bufferSize;
+        max_run = maxRuns;
+    }
+
+    ~ExternalPriorityQueue() {
+        for (Run_file<ValueType>* run : runs) {
+            closeRun(run);
+        }
+        rmdir(run_directory.c_str());
+    }
+
+    ExternalPriorityQueue(const ExternalPriorityQueue& rhs) = delete;
+    ExternalPriorityQueue& operator=(const ExternalPriorityQueue& rhs) = delete;
+
+    /**
+     * All of these must run in constant time.
+     */
+    unsigned long long numElements() const {
+        return num_element;
+    }
+    unsigned numRuns() const {
+        return (unsigned) runs.size();
+    }
+
+    /**
+     * Inserts a key-value pair mapping @key to @value into
+     * the priority queue. A full insertion heap is spilled to disk first.
+     *
+     * Returns true if success.
+     * Returns false if @key is already in the insertion heap.
+     *
+     * Throws std::runtime_error if writing a run fails, in which case
+     * @key is not inserted.
+     */
+    bool insert(unsigned key, const ValueType& value) {
+        if (heap.get(key) != nullptr) {
+            return false;
+        }
+        if (heap.numElements() == heap.maxSize()) {
+            spill();
+        }
+
+        heap.insert(key, value);
+        num_element++;
+        return true;
+    }
+
+    /**
+     * Returns key of the smallest element in the priority queue
+     * or null pointer if empty.
+     */
+    const unsigned* getMinKey() const {
+        Run_file<ValueType>* run = minRun();
+        if (run == nullptr) {
+            return heap.getMinKey();
+        }
+        return &run->buffer[run->head].key;
+    }
+
+    /**
+     * Returns value of the smallest element in the priority queue
+     * or null pointer if empty.
+     */
+    const ValueType* getMinValue() const {
+        Run_file<ValueType>* run = minRun();
+        if (run == nullptr) {
+            return heap.getMinValue();
+        }
+        return &run->buffer[run->head].value;
+    }
+
+    /**
+     * Returns true if success.
+     * Returns false if priority queue is empty, i.e. nothing to delete.
+     *
+     * Throws std::runtime_error if reading a run fails.
+     */
+    bool deleteMin() {
+        Run_file<ValueType>* run = minRun();
+        if (run == nullptr) {
+            if (!heap.deleteMin()) {
+                return false;
+            }
+        } else {
+            advanceWinner();
+        }
+
+        num_element--;
+        return true;
+    }
+
+private:
+    /**
+     * Returns the run whose front element is smaller than every other
+     * element, or null pointer if the insertion heap holds the smallest.
+     */
+    Run_file<ValueType>* minRun() const {
+        if (runs.empty()) {
+            return nullptr;
+        }
+        Run_file<ValueType>* best = runs[run_tree[0]];
+
+        const unsigned* heap_min = heap.getMinKey();
+        if (heap_min != nullptr &&
+            *heap_min < best->buffer[best->head].key) {
+            return nullptr;
+        }
+        return best;
+    }
+
+    /**
+     * Writes the insertion heap out as a new run on level 0, then merges
+     * any level that has filled up.
+     */
+    void spill() {
+        std::vector<Record_run<ValueType>> out;
+        out.reserve(size_buffer);
+        std::ofstream os;
+        Run_file<ValueType>* run = createRun(0, os);
+
+        // The heap only lets go of its elements once they are on disk.
+        bool has_records;
+        try {
+            heap.visitSorted([this, &os, &out](unsigned key, const ValueType& value) {
+                out.push_back(Record_run<ValueType>{key, value});
+                if (out.size() == size_buffer) {
+                    writeBuffer(os, out);
+                }
+            });
+            writeBuffer(os, out);
+            has_records = finishRun(run, os);
+        } catch (...) {
+            os.close();
+            closeRun(run);
+            throw;
+        }
+        heap.clear();
+        addRun(run, has_records);
+
+        for (unsigned level = 0; countLevel(level) >= max_run; ++level) {
+            mergeLevel(level);
+        }
+    }
+
+    /**
+     * Merges the runs of @level into one run on the level above.
+     * Only the records that were not deleted yet are copied.
+     */
+    void mergeLevel(unsigned level) {
+        std::vector<Run_file<ValueType>*> group;
+        std::vector<Run_file<ValueType>*> rest;
+        for (Run_file<ValueType>* run : runs) {
+            (run->level == level ? group : rest).push_back(run);
+        }
+
+        std::vector<Record_run<ValueType>> out;
+        out.reserve(size_buffer);
+        std::ofstream os;
+        Run_file<ValueType>* merged = createRun(level + 1, os);
+
+        // The merge reads through readers of its own, so the runs of the
+        // level stay untouched until the merged run is complete.
+        std::vector<Run_file<ValueType>*> readers;
+        bool has_records;
+        try {
+            readers.reserve(group.size());
+            for (Run_file<ValueType>* run : group) {
+                readers.push_back(openReader(run));
+            }
+
+            // Exhausted readers stay in the tree, losing every match,
+            // until the winner itself is exhausted.
+            std::vector<unsigned> tree;
+            buildTree(readers, tree);
+            while (frontKey(readers[tree[0]]) != ULLONG_MAX) {
+                Run_file<ValueType>* reader = readers[tree[0]];
+                out.push_back(reader->buffer[reader->head]);
+                if (out.size() == size_buffer) {
+                    writeBuffer(os, out);
+                }
+                nextRecord(reader);
+                replayTree(readers, tree, tree[0]);
+            }
+            writeBuffer(os, out);
+            has_records = finishRun(merged, os);
+        } catch (...) {
+            for (Run_file<ValueType>* reader : readers) {
+                delete reader;
+            }
+            os.close();
+            closeRun(merged);
+            throw;
+        }
+
+        for (Run_file<ValueType>* reader : readers) {
+            delete reader;
+        }
+        for (Run_file<ValueType>* run : group) {
+            closeRun(run);
+        }
+        runs = rest;
+        addRun(merged, has_records);
+    }
+
+    /**
+     * Returns the key of the front record of @run, or ULLONG_MAX if
+     * the run has no records left.
+     */
+    static unsigned long long frontKey(const Run_file<ValueType>* run) {
+        if (run->head >= run->buffer.size()) {
+            return ULLONG_MAX;
+        }
+        return run->buffer[run->head].key;
+    }
+
+    /**
+     * Builds a loser tree over the fronts of @group. Leaf i + k stands
+     * for run i, where k is the number of runs; every inner node keeps
+     * the index of the run that lost the match played there, and
+     * @tree[0] the index of the overall winner.
+     */
+    static void buildTree(const std::vector<Run_file<ValueType>*>& group,
+                          std::vector<unsigned>& tree) {
+        tree.assign(group.size(), 0);
+        if (!group.empty()) {
+            tree[0] = playMatches(group, tree, 1);
+        }
+    }
+
+    static unsigned playMatches(const std::vector<Run_file<ValueType>*>& group,
+                                std::vector<unsigned>& tree, unsigned node) {
+        unsigned k = (unsigned) group.size();
+        if (node >= k) {
+            return node - k;
+        }
+        unsigned left = playMatches(group, tree, 2 * node);
+        unsigned right = playMatches(group, tree, 2 * node + 1);
+        if (frontKey(group[right]) < frontKey(group[left])) {
+            tree[node] = left;
+            return right;
+        }
+        tree[node] = right;
+        return left;
+    }
+
+    /**
+     * Replays the matches from the leaf of run @winner, the previous
+     * winner, up to the root after its front has moved on.
+     */
+    static void replayTree(const std::vector<Run_file<ValueType>*>& group,
+                           std::vector<unsigned>& tree, unsigned winner) {
+        unsigned k = (unsigned) group.size();
+        for (unsigned node = (winner + k) / 2; node > 0; node /= 2) {
+            if (frontKey(group[tree[node]]) < frontKey(group[winner])) {
+                std::swap(tree[node], winner);
+            }
+        }
+        tree[0] = winner;
+    }
+
+    /**
+     * Opens a new run file for writing into @os.
+     * The run is not added to @runs until addRun().
+     */
+    Run_file<ValueType>* createRun(unsigned level, std::ofstream& os) {
+        Run_file<ValueType>* run = new Run_file<ValueType>;
+        run->path = path_prefix + std::to_string(num_run_created++) + ".bin";
+        run->level = level;
+
+        os.open(run->path, std::ios::binary | std::ios::trunc);
+        if (!os) {
+            delete run;
+            throw std::runtime_error("Failed to create run file.");
+        }
+        return run;
+    }
+
+    /**
+     * Closes the finished file behind @os and reopens it for reading.
+     * Returns false if the run has no records.
+     * If this throws, @run is left to the caller to close.
+     */
+    bool finishRun(Run_file<ValueType>* run, std::ofstream& os) {
+        run->remaining = (unsigned long long) os.tellp() / sizeof(Record_run<ValueType>);
+        os.close();
+        if (!os) {
+            throw std::runtime_error("Failed to write run file.");
+        }
+
+        run->in.open(run->path, std::ios::binary);
+        if (!run->in) {
+            throw std::runtime_error("Failed to open run file.");
+        }
+        run->buffer.reserve(size_buffer);
+        return refill(run);
+    }
+
+    /**
+     * Adds the finished @run to the runs, or drops it if it has no
+     * records, and rebuilds the tree.
+     */
+    void addRun(Run_file<ValueType>* run, bool hasRecords) {
+        if (hasRecords) {
+            runs.push_back(run);
+        } else {
+            closeRun(run);
+        }
+        buildTree(runs, run_tree);
+    }
+
+    /**
+     * Opens a second reader on @run that starts at its front record.
+     * The reader shares the file of @run, so it is deleted rather than
+     * closed with closeRun().
+     */
+    Run_file<ValueType>* openReader(Run_file<ValueType>* run) {
+        std::streamoff offset = run->in.tellg();
+        Run_file<ValueType>* reader = new Run_file<ValueType>;
+        try {
+            reader->path = run->path;
+            reader->level = run->level;
+            reader->buffer.assign(run->buffer.begin() + run->head, run->buffer.end());
+            reader->remaining = run->remaining;
+            reader->in.open(run->path, std::ios::binary);
+            reader->in.seekg(offset);
+            if (offset < 0 || !reader->in) {
+                throw std::runtime_error("Failed to open run file.");
+            }
+        } catch (...) {
+            delete reader;
+            throw;
+        }
+        return reader;
+    }
+
+    void writeBuffer(std::ofstream& os, std::vector<Record_run<ValueType>>& out) {
+        os.write((const char*) out.data(),
+                 (std::streamsize) (out.size() * sizeof(Record_run<ValueType>)));
+        if (!os) {
+            throw std::runtime_error("Failed to write run file.");
+        }
+        out.clear();
+    }
+
+    /**
+     * Reads the next block of @run into its buffer.
+     * Returns false if the run has no records left.
+     */
+    bool refill(Run_file<ValueType>* run) {
+        unsigned n = run->remaining < size_buffer ? (unsigned) run->remaining : size_buffer;
+        if (n == 0) {
+            return false;
+        }
+
+        run->buffer.resize(n);
+        run->in.read((char*) run->buffer.data(),
+                     (std::streamsize) (n * sizeof(Record_run<ValueType>)));
+        if (!run->in) {
+            throw std::runtime_error("Failed to read run file.");
+        }
+        run->remaining -= n;
+        run->head = 0;
+        return true;
+    }
+
+    /**
+     * Moves @run on to its next record.
+     * Returns false if the run has no records left.
+     */
+    bool nextRecord(Run_file<ValueType>* run) {
+        run->head++;
+        return run->head < run->buffer.size() || refill(run);
+    }
+
+    /**
+     * Drops the front record of the winning run. A run that is used up
+     * is deleted and the tree rebuilt, which happens once per run.
+     */
+    void advanceWinner() {
+        unsigned winner = run_tree[0];
+        Run_file<ValueType>* run = runs[winner];
+        if (nextRecord(run)) {
+            replayTree(runs, run_tree, winner);
+            return;
+        }
+
+        runs[winner] = runs.back();
+        runs.pop_back();
+        closeRun(run);
+        buildTree(runs, run_tree);
+    }
+
+    void closeRun(Run_file<ValueType>* run) {
+        run->in.close();
+        std::remove(run->path.c_str());
+        delete run;
+    }
+
+    unsigned countLevel(unsigned level) const {
+        unsigned count = 0;
+        for (Run_file<ValueType>* run : runs) {
+            if (run->level == level) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    PriorityQueue<ValueType> heap;
+    std::vector<Run_file<ValueType>*> runs;
+    // Loser tree over the fronts of @runs.
+    std::vector<unsigned> run_tree;
+    std::string run_directory;
+    std::string path_prefix;
+    unsigned long long num_element = 0;
+    unsigned num_run_created = 0;
+    unsigned size_buffer;
+    unsigned max_run;
+};
+
+#endif  // EXTERNAL_PRIORITY_QUEUE_HPP
@@ -1,7 +1,46 @@
 #ifndef HASH_TABLE_HPP
 #define HASH_TABLE_HPP
 
+#include <functional>
 #include <iostream>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Defining HASH_TABLE_STATS before including this header makes every
+ * HashTable count its lookups and how many slots each of them probed.
+ * Without it the counting compiles away entirely.
+ */
+// PriorityQueue reports the probe statistics of its key map, so its
+// switch turns these on too, whichever of the two headers comes first.
+#if defined(PRIORITY_QUEUE_STATS) && !defined(HASH_TABLE_STATS)
+#define HASH_TABLE_STATS
+#endif
+
+#ifdef HASH_TABLE_STATS
+#define HT_STATS(statement) statement
+#else
+#define HT_STATS(statement)
+#endif
+
+#ifdef HASH_TABLE_STATS
+struct HashTableStats
+{
+    static const unsigned NUM_PROBE_BUCKET = 16;
+    // Calls to insert(), get(), update() and remove().
+    unsigned long long lookups = 0;
+    // Slots visited by those calls.
+    unsigned long long probes = 0;
+    // Lookups by number of slots visited; the last bucket holds all longer ones.
+    unsigned long long probe_length[NUM_PROBE_BUCKET] = {};
+    // Times the table was rebuilt to grow or to clear deleted slots.
+    unsigned long long rebuilds = 0;
+};
+#endif
+
 /**
  * Implementation of a hash table that stores key-value
  * pairs mapping unsigned integers to instances of
@@ -10,6 +49,20 @@
  * Hash function: key % tableSize
  * Collision resolution: quadratic probing.
  * Non-unique keys are not supported.
+ *
+ * If std::hash<ValueType> exists, the table keeps a fingerprint of
+ * its contents up to date as elements come and go. Other value types
+ * work as before, without fingerprint().
+ *
+ * Tables of up to inlineSlotsFor(InlineEntries) slots, which is room
+ * for InlineEntries elements, live inside the object rather than on
+ * the heap, so small tables cost no allocation. Growth is the same as
+ * for any other table, so a table moves to the heap once its next size
+ * is past the inline slots: a HashTable(7) keeps 8 elements inline, a
+ * HashTable(11) only 5. The inline slots are raw storage, and only
+ * constructed while the table uses them. By default InlineEntries is
+ * as many elements, up to 8, as fit in 1 KB of slots, and 0 for value
+ * types too big for even one, which keeps every table on the heap.
  */
 
 template <typename ValueType>
@@ -21,9 +74,59 @@ struct Slot
     bool is_deleted = false;
 };
 
-template <typename ValueType>
+/**
+ * Returns the number of slots a table needs to hold @entries elements,
+ * i.e. the smallest prime above 2 * @entries, as a table is rebuilt
+ * before its load reaches 0.5. Returns 0 if @entries is 0.
+ */
+constexpr unsigned inlineSlotsFor(unsigned entries) {
+    if (entries == 0) {
+        return 0;
+    }
+    unsigned n = entries * 2 + 1;
+    for (unsigned i = 2; i * i <= n; ++i) {
+        if (n % i == 0) {
+            n++;
+            i = 1;
+        }
+    }
+    return n;
+}
+
+/**
+ * True if std::hash<T> can hash a T, which HashTable needs to keep a
+ * fingerprint.
+ */
+template <typename T, typename = void>
+struct IsHashable : std::false_type {};
+
+template <typename T>
+struct IsHashable<T, decltype((void) std::hash<T>()(std::declval<const T&>()))>
+    : std::true_type {};
+
+/**
+ * Returns the default InlineEntries for slots of @slotBytes bytes: the
+ * most elements, up to 8, whose inline slots fit in 1 KB, or 0 if not
+ * even one element does.
+ */
+constexpr unsigned defaultInlineEntries(std::size_t slotBytes) {
+    for (unsigned entries = 8; entries > 0; --entries) {
+        if (inlineSlotsFor(entries) * slotBytes <= 1024) {
+            return entries;
+        }
+    }
+    return 0;
+}
+
+template <typename ValueType,
+          unsigned InlineEntries = defaultInlineEntries(sizeof(Slot<ValueType>))>
 class HashTable
 {
+    static const unsigned INLINE_SLOTS = inlineSlotsFor(InlineEntries);
+    // At least one byte, so the storage is never a zero-sized array.
+    static const std::size_t INLINE_BYTES =
+        INLINE_SLOTS > 0 ? sizeof(Slot<ValueType>) * INLINE_SLOTS : 1;
+
 public:
     /**
      * Creates a hash table with the given number of
@@ -39,16 +142,16 @@ public:
             throw std::runtime_error("Table size is 0.");
         }
 
-        for (unsigned i = 2; i < tableSize / 2; i++) {
+        for (unsigned i = 2; i < tableSize / 2 && i * i <= tableSize; i++) {
             if ((tableSize % i) == 0) {
                 throw std::runtime_error("Table size is NOT prime.");
             }
         }
-        slot = new Slot<ValueType>[tableSize];
+        slot = allocate(tableSize);
     }
 
     ~HashTable() {
-        delete[] slot;
+        release();
     }
 
     /**
@@ -56,9 +159,12 @@ public:
      * exactly the same as that of @rhs.
      */
     HashTable(const HashTable& rhs) {
-        slot = new struct Slot<ValueType>[rhs.size_table];
+        slot = allocate(rhs.size_table);
         size_table = rhs.size_table;
         num_element = rhs.num_element;
+        num_deleted = rhs.num_deleted;
+        fingerprint_sum = rhs.fingerprint_sum;
+        is_fingerprint_dirty = rhs.is_fingerprint_dirty;
 
         for (std::size_t i = 0; i < size_table; ++i) {
             slot[i] = rhs.slot[i];
@@ -66,9 +172,16 @@ public:
     }
 
     HashTable& operator=(const HashTable& rhs) {
-        slot = new struct Slot<ValueType>[rhs.size_table];
+        if (this == &rhs) {
+            return *this;
+        }
+        release();
+        slot = allocate(rhs.size_table);
         size_table = rhs.size_table;
         num_element = rhs.num_element;
+        num_deleted = rhs.num_deleted;
+        fingerprint_sum = rhs.fingerprint_sum;
+        is_fingerprint_dirty = rhs.is_fingerprint_dirty;
 
         for (std::size_t i = 0; i < size_table; ++i) {
             slot[i] = rhs.slot[i];
@@ -83,21 +196,37 @@ public:
      * After this, @rhs should be in a "moved from" state.
      */
     HashTable(HashTable&& rhs) noexcept {
-        slot = rhs.slot;
+        takeSlots(rhs);
         size_table = rhs.size_table;
         num_element = rhs.num_element;
+        num_deleted = rhs.num_deleted;
+        fingerprint_sum = rhs.fingerprint_sum;
+        is_fingerprint_dirty = rhs.is_fingerprint_dirty;
         rhs.slot = nullptr;
         rhs.size_table = 0;
         rhs.num_element = 0;
+        rhs.num_deleted = 0;
+        rhs.fingerprint_sum = 0;
+        rhs.is_fingerprint_dirty = false;
     }
 
     HashTable& operator=(HashTable&& rhs) noexcept {
-        slot = rhs.slot;
+        if (this == &rhs) {
+            return *this;
+        }
+        release();
+        takeSlots(rhs);
         size_table = rhs.size_table;
         num_element = rhs.num_element;
+        num_deleted = rhs.num_deleted;
+        fingerprint_sum = rhs.fingerprint_sum;
+        is_fingerprint_dirty = rhs.is_fingerprint_dirty;
         rhs.slot = nullptr;
         rhs.size_table = 0;
         rhs.num_element = 0;
+        rhs.num_deleted = 0;
+        rhs.fingerprint_sum = 0;
+        rhs.is_fingerprint_dirty = false;
 
         return *this;
     }
@@ -112,11 +241,19 @@ public:
         return num_element;
     }
 
+    /**
+     * Returns true if the slots live inside the object rather than on
+     * the heap. Runs in constant time.
+     */
+    bool isInline() const {
+        return slot == reinterpret_cast<const Slot<ValueType>*>(inline_storage);
+    }
+
     /**
      * Prints each bucket in the hash table.
      */
     friend std::ostream& operator<<(std::ostream& os,
-                                    const HashTable<ValueType>& ht)
+                                    const HashTable& ht)
     {
         for (std::size_t i = 0; i < ht.size_table; ++i) {
             if (ht.slot[i].is_empty || ht.slot[i].is_deleted) {
@@ -129,46 +266,8 @@ public:
         return os;
     }
     void rehash(unsigned key, const ValueType& value) {
-        bool is_prime = false;
-        unsigned size_prev_table = size_table;
-
         if(((double)(num_element + 1) / (double)size_table) >= 0.5) {
-
-            size_table *= 2;
-            while(!is_prime) {
-                size_table++;
-                bool flag_prime = true;
-                for (unsigned i = 2; i < size_table; ++i) {
-                    if (size_table % i == 0) {
-                        flag_prime = false;
-                        break;
-                    }
-                }
-                if(flag_prime) {
-                    is_prime = true;
-                }
-            }
-
-            unsigned copy_key[size_prev_table];
-            ValueType copy_value[size_prev_table];
-            unsigned copy_array_index = 0;
-
-            for (unsigned i = 0; i < size_prev_table; ++i) {
-                if (!slot[i].is_empty && !slot[i].is_deleted) {
-                    copy_key[copy_array_index] = slot[i].key;
-                    copy_value[copy_array_index] = slot[i].value;
-                    copy_array_index++;
-                }
-            }
-
-            delete[] slot;
-            slot = new Slot<ValueType>[size_table];
-
-            num_element = 0;
-            for (unsigned i = 0; i < copy_array_index; ++i) {
-                insert(copy_key[i], copy_value[i]);
-            }
-
+            rebuild(nextPrime(size_table * 2));
             insert(key, value);
         }
     }
@@ -189,6 +288,7 @@ public:
             Slot<ValueType>* tmp_slot = &slot[(key + (quadratic * quadratic)) % size_table];
 
             if (!tmp_slot->is_empty && tmp_slot->key == key) {
+                HT_STATS(recordProbe(quadratic + 1));
                 return false;
             }
 
@@ -203,49 +303,214 @@ public:
 
             quadratic++;
         }
+        HT_STATS(recordProbe(quadratic + 1));
 
         if (((double)(num_element + 1) / (double)size_table) >= 0.5){
             rehash(key, value);
+        } else if (!slot[slot_insert_index].is_deleted &&
+                   ((double)(num_element + num_deleted + 1) / (double)size_table) >= 0.5) {
+            // Deleted slots never end a probe sequence, so once they pile up
+            // lookups of missing keys would never terminate. Clear them out,
+            // and grow too if that would not leave room for more churn.
+            if (num_element * 4 >= size_table) {
+                rebuild(nextPrime(size_table * 2));
+            } else {
+                rebuild(size_table);
+            }
+            insert(key, value);
         } else {
+            if (slot[slot_insert_index].is_deleted) {
+                num_deleted--;
+            }
             slot[slot_insert_index].key = key;
             slot[slot_insert_index].value = value;
             slot[slot_insert_index].is_empty = false;
             slot[slot_insert_index].is_deleted = false;
             num_element++;
+            fingerprint_sum += entryHash(key, value);
         }
         return true;
     }
 
+    /**
+     * Inserts the @count keys in @keys, mapping @keys[i] to @valueOf(i),
+     * using @numThreads threads. @valueOf is called from all of them
+     * at once.
+     *
+     * The table first grows to fit the whole batch. Each thread then
+     * owns a contiguous range of slots, takes the keys whose home slot
+     * is in it, and places every key whose probe sequence finds a free
+     * slot before leaving the range, so no two threads write the same
+     * slot. The few keys whose probes leave the range are inserted
+     * afterwards on the calling thread.
+     *
+     * Returns true if success.
+     * Returns false if a key appears twice in @keys or is already in
+     * the table (in which case, the other keys are still inserted).
+     */
+    template <typename ValueOf>
+    bool insertAll(const unsigned* keys, unsigned count, ValueOf valueOf,
+                   unsigned numThreads = 1) {
+        // Placing keys would race on the shared probe counters.
+        HT_STATS(numThreads = 1);
+        // A thread needs enough keys to be worth starting.
+        if (numThreads > count / 4096) {
+            numThreads = count / 4096;
+        }
+        if (numThreads <= 1) {
+            bool is_unique = true;
+            for (unsigned i = 0; i < count; ++i) {
+                if (!insert(keys[i], valueOf(i))) {
+                    is_unique = false;
+                }
+            }
+            return is_unique;
+        }
+
+        // Grow once up front, and drop the deleted slots, so that none
+        // of the inserts below rebuilds the table.
+        unsigned new_size = size_table;
+        while (((double)(num_element + count + 1) / (double)new_size) >= 0.5) {
+            new_size = nextPrime(new_size * 2);
+        }
+        if (new_size != size_table || num_deleted > 0) {
+            rebuild(new_size);
+        }
+
+        // Group the key indices by the thread that owns their home slot.
+        std::vector<unsigned> order(count);
+        std::vector<unsigned> bucket_count(numThreads * numThreads, 0);
+        runThreads(numThreads, [&](unsigned chunk) {
+            unsigned* counts = &bucket_count[chunk * numThreads];
+            for (unsigned i = chunkBegin(count, numThreads, chunk);
+                 i < chunkBegin(count, numThreads, chunk + 1); ++i) {
+                counts[owner(keys[i] % size_table, numThreads)]++;
+            }
+        });
+        std::vector<unsigned> bucket_begin(numThreads + 1, 0);
+        std::vector<unsigned> scatter_at(numThreads * numThreads);
+        unsigned position = 0;
+        for (unsigned t = 0; t < numThreads; ++t) {
+            bucket_begin[t] = position;
+            for (unsigned chunk = 0; chunk < numThreads; ++chunk) {
+                scatter_at[chunk * numThreads + t] = position;
+                position += bucket_count[chunk * numThreads + t];
+            }
+        }
+        bucket_begin[numThreads] = position;
+        runThreads(numThreads, [&](unsigned chunk) {
+            unsigned* at = &scatter_at[chunk * numThreads];
+            for (unsigned i = chunkBegin(count, numThreads, chunk);
+                 i < chunkBegin(count, numThreads, chunk + 1); ++i) {
+                order[at[owner(keys[i] % size_table, numThreads)]++] = i;
+            }
+        });
+
+        std::vector<Bulk_insert> result(numThreads);
+        runThreads(numThreads, [&](unsigned t) {
+            Bulk_insert& mine = result[t];
+            for (unsigned j = bucket_begin[t]; j < bucket_begin[t + 1]; ++j) {
+                unsigned i = order[j];
+                unsigned key = keys[i];
+                unsigned quadratic = 0;
+                while (true) {
+                    unsigned index = (key + (quadratic * quadratic)) % size_table;
+                    if (owner(index, numThreads) != t) {
+                        mine.overflow.push_back(i);
+                        break;
+                    }
+                    Slot<ValueType>* tmp_slot = &slot[index];
+                    if (!tmp_slot->is_empty && tmp_slot->key == key) {
+                        mine.is_unique = false;
+                        break;
+                    }
+                    if (tmp_slot->is_empty && !tmp_slot->is_deleted) {
+                        tmp_slot->key = key;
+                        tmp_slot->value = valueOf(i);
+                        tmp_slot->is_empty = false;
+                        mine.num_placed++;
+                        mine.fingerprint_sum += entryHash(key, tmp_slot->value);
+                        break;
+                    }
+                    quadratic++;
+                }
+            }
+        });
+
+        bool is_unique = true;
+        for (const Bulk_insert& mine : result) {
+            num_element += mine.num_placed;
+            fingerprint_sum += mine.fingerprint_sum;
+            is_unique = is_unique && mine.is_unique;
+        }
+        for (const Bulk_insert& mine : result) {
+            for (unsigned i : mine.overflow) {
+                if (!insert(keys[i], valueOf(i))) {
+                    is_unique = false;
+                }
+            }
+        }
+        return is_unique;
+    }
+
     /**
      * Finds the value corresponding to the given key
      * and returns its address.
      *
      * Returns null pointer if @key is not in the table.
+     *
+     * The value may be changed through the returned pointer, so a hit
+     * leaves the fingerprint stale until fingerprint() is called on
+     * the table. Lookups through a const table keep it current.
      */
     ValueType* get(unsigned key) {
-        // bool flag_found = false;
-        // unsigned index_original = key % size_table;
-        // slot_insert_index = (key + (quadratic * quadratic)) % size_table;
-        unsigned slot_insert_index;
-        unsigned quadratic = 0;
-
-        while (true) {
-            slot_insert_index = (key + (quadratic * quadratic)) % size_table;
+        ValueType* value = find(key);
+        // The caller may change the value through the pointer.
+        if (value != nullptr) {
+            is_fingerprint_dirty = true;
+        }
+        return value;
+    }
 
-            if(!slot[slot_insert_index].is_empty && slot[slot_insert_index].key == key) {
-                return &slot[slot_insert_index].value;
+    const ValueType* get(unsigned key) const {
+        return ((HashTable*) this) -> find(key);
+    }
 
-            } else if (slot[slot_insert_index].is_empty && !slot[slot_insert_index].is_deleted) {
-                break;
-            } else {
-                quadratic++;
-            }
+    /**
+     * Returns a 64-bit fingerprint of the elements in the table.
+     * Tables holding the same elements have the same fingerprint,
+     * whatever their size or insertion order, so it can be compared
+     * across processes running the same build.
+     *
+     * Runs in constant time, unless the fingerprint is stale after
+     * a get() hit, in which case this rescans the table once and
+     * brings it up to date.
+     */
+    unsigned long long fingerprint() {
+        static_assert(IsHashable<ValueType>::value, "fingerprint() needs std::hash<ValueType>.");
+        if (is_fingerprint_dirty) {
+            fingerprint_sum = sumEntries();
+            is_fingerprint_dirty = false;
         }
-        return nullptr;
+        return fingerprint_sum;
     }
 
-    const ValueType* get(unsigned key) const {
-        return ((HashTable*) this) -> get(key);
+    /**
+     * Same as above, but never writes to the table, so it is safe to
+     * call from several threads at once. After a non-const get(), each
+     * call rescans the table until the non-const overload is called.
+     */
+    unsigned long long fingerprint() const {
+        static_assert(IsHashable<ValueType>::value, "fingerprint() needs std::hash<ValueType>.");
+        return is_fingerprint_dirty ? sumEntries() : fingerprint_sum;
+    }
+
+    /**
+     * Returns true if the fingerprint is up to date, which is what lets
+     * operator== reject different tables in constant time.
+     */
+    bool isFingerprintCurrent() const {
+        return !is_fingerprint_dirty;
     }
 
     /**
@@ -263,7 +528,10 @@ public:
             slot_insert_index = (key + (quadratic * quadratic)) % size_table;
 
             if(!slot[slot_insert_index].is_empty && slot[slot_insert_index].key == key) {
+                fingerprint_sum -= entryHash(key, slot[slot_insert_index].value);
+                fingerprint_sum += entryHash(key, newValue);
                 slot[slot_insert_index].value = newValue;
+                HT_STATS(recordProbe(quadratic + 1));
                 return true;
 
             } else if (slot[slot_insert_index].is_empty && !slot[slot_insert_index].is_deleted) {
@@ -272,6 +540,7 @@ public:
                 quadratic++;
             }
         }
+        HT_STATS(recordProbe(quadratic + 1));
         return false;
     }
 
@@ -289,17 +558,20 @@ public:
         while (!flag_found) {
             slot_insert_index = (key + (quadratic * quadratic)) % size_table;
 
-            if(slot[slot_insert_index].key == key) {
+            if(!slot[slot_insert_index].is_empty && slot[slot_insert_index].key == key) {
                 slot[slot_insert_index].is_deleted = true;
                 slot[slot_insert_index].is_empty = true;
+                fingerprint_sum -= entryHash(key, slot[slot_insert_index].value);
                 num_element--;
+                num_deleted++;
                 flag_found = true;
-            } else if (slot[slot_insert_index].is_empty) {
+            } else if (slot[slot_insert_index].is_empty && !slot[slot_insert_index].is_deleted) {
                 break;
             } else {
                 quadratic++;
             }
         }
+        HT_STATS(recordProbe(quadratic + 1));
         return flag_found;
     }
 
@@ -309,16 +581,18 @@ public:
      * Returns the number of elements deleted.
      */
     unsigned removeAllByValue(const ValueType& value) {
-        unsigned num_deleted = 0;
+        unsigned num_removed = 0;
         for (unsigned i = 0; i < size_table; ++i) {
             if (!slot[i].is_empty && slot[i].value == value) {
+                fingerprint_sum -= entryHash(slot[i].key, slot[i].value);
                 slot[i].is_empty = true;
                 slot[i].is_deleted = true;
-                num_deleted++;
+                num_removed++;
             }
         }
-        num_element -= num_deleted;
-        return num_deleted;
+        num_element -= num_removed;
+        num_deleted += num_removed;
+        return num_removed;
     }
 
     /**
@@ -326,11 +600,24 @@ public:
      * equal if they contain the same elements, even if those
      * elements are in different buckets (i.e. even if the
      * hash tables have different sizes).
+     *
+     * Tables whose fingerprints differ are rejected in constant time,
+     * but only while both fingerprints are current. After a get() hit,
+     * call fingerprint() on that table before comparing it, or this
+     * falls back to comparing every element.
      */
     bool operator==(const HashTable& rhs) const {
         if (num_element != rhs.num_element) {
             return false;
         }
+        // Different fingerprints mean different elements. Equal ones
+        // are almost always a match, but the scan below makes sure.
+        // A stale fingerprint would cost a scan of its own, so it is
+        // only checked when both are up to date.
+        if (!is_fingerprint_dirty && !rhs.is_fingerprint_dirty &&
+            fingerprint_sum != rhs.fingerprint_sum) {
+            return false;
+        }
 
         for (unsigned i = 0; i < size_table; ++i) {
             if(!slot[i].is_empty) {
@@ -344,20 +631,7 @@ public:
     }
 
     bool operator!=(const HashTable& rhs) const {
-        if (num_element != rhs.num_element) {
-            return true;
-        }
-
-        for (unsigned i = 0; i < size_table; ++i) {
-
-            if(!slot[i].is_empty) {
-                const ValueType* value = rhs.get(slot[i].key);
-                if(value == nullptr || *value != slot[i].value) {
-                    return true;
-                }
-            }
-        }
-        return false;
+        return !(*this == rhs);
     }
 
     /**
@@ -367,7 +641,7 @@ public:
      * into this (i.e. *this) hash table.
      */
     HashTable operator+(const HashTable& rhs) const {
-        HashTable<ValueType> hash_table = *this;
+        HashTable hash_table = *this;
 
         for(unsigned i = 0; i < rhs.size_table; ++i) {
             if (!rhs.slot[i].is_empty) {
@@ -377,10 +651,276 @@ public:
         return hash_table;
     }
 
+#ifdef HASH_TABLE_STATS
+    const HashTableStats& stats() const {
+        return table_stats;
+    }
+    void resetStats() {
+        table_stats = HashTableStats();
+    }
+#endif
+
 private:
+#ifdef HASH_TABLE_STATS
+    void recordProbe(unsigned length) {
+        table_stats.lookups++;
+        table_stats.probes += length;
+        unsigned bucket = length - 1;
+        if (bucket >= HashTableStats::NUM_PROBE_BUCKET) {
+            bucket = HashTableStats::NUM_PROBE_BUCKET - 1;
+        }
+        table_stats.probe_length[bucket]++;
+    }
+#endif
+
+    /**
+     * Hashes one element. The fingerprint is the sum of these over all
+     * elements, so it does not depend on their order.
+     */
+    static unsigned long long entryHash(unsigned key, const ValueType& value) {
+        return entryHash(key, value, IsHashable<ValueType>());
+    }
+
+    static unsigned long long entryHash(unsigned key, const ValueType& value, std::true_type) {
+        unsigned long long x = std::hash<ValueType>()(value) +
+                               0x9E3779B97F4A7C15ULL * ((unsigned long long) key + 1);
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    // Without std::hash there is no fingerprint to keep up to date.
+    static unsigned long long entryHash(unsigned, const ValueType&, std::false_type) {
+        return 0;
+    }
+
+    unsigned long long sumEntries() const {
+        unsigned long long sum = 0;
+        for (unsigned i = 0; i < size_table; ++i) {
+            if (!slot[i].is_empty) {
+                sum += entryHash(slot[i].key, slot[i].value);
+            }
+        }
+        return sum;
+    }
+
+    ValueType* find(unsigned key) {
+        // bool flag_found = false;
+        // unsigned index_original = key % size_table;
+        // slot_insert_index = (key + (quadratic * quadratic)) % size_table;
+        unsigned slot_insert_index;
+        unsigned quadratic = 0;
+
+        while (true) {
+            slot_insert_index = (key + (quadratic * quadratic)) % size_table;
+
+            if(!slot[slot_insert_index].is_empty && slot[slot_insert_index].key == key) {
+                HT_STATS(recordProbe(quadratic + 1));
+                return &slot[slot_insert_index].value;
+
+            } else if (slot[slot_insert_index].is_empty && !slot[slot_insert_index].is_deleted) {
+                break;
+            } else {
+                quadratic++;
+            }
+        }
+        HT_STATS(recordProbe(quadratic + 1));
+        return nullptr;
+    }
+
+    // What one thread of insertAll() did.
+    struct Bulk_insert
+    {
+        unsigned num_placed = 0;
+        unsigned long long fingerprint_sum = 0;
+        bool is_unique = true;
+        // Indices of the keys left for the calling thread.
+        std::vector<unsigned> overflow;
+    };
+
+    /**
+     * Returns the thread of @numThreads that owns slot @index in
+     * insertAll().
+     */
+    unsigned owner(unsigned index, unsigned numThreads) const {
+        return (unsigned)((unsigned long long) index * numThreads / size_table);
+    }
+
+    static unsigned chunkBegin(unsigned count, unsigned numThreads, unsigned chunk) {
+        return (unsigned)((unsigned long long) count * chunk / numThreads);
+    }
+
+    /**
+     * Calls @work(t) for every t below @numThreads, each on its own
+     * thread, t = 0 on the calling one.
+     */
+    template <typename Work>
+    static void runThreads(unsigned numThreads, Work work) {
+        std::vector<std::thread> workers;
+        try {
+            for (unsigned t = 1; t < numThreads; ++t) {
+                workers.emplace_back(work, t);
+            }
+            work(0u);
+        } catch (...) {
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+            throw;
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    Slot<ValueType>* inlineSlots() {
+        return reinterpret_cast<Slot<ValueType>*>(inline_storage);
+    }
+
+    /**
+     * Returns @size slots, all empty: the inline ones if they are
+     * enough, a new array otherwise.
+     * The inline slots must not be in use.
+     */
+    Slot<ValueType>* allocate(unsigned size) {
+        if (size > INLINE_SLOTS) {
+            return new Slot<ValueType>[size];
+        }
+        Slot<ValueType>* inline_slot = inlineSlots();
+        for (unsigned i = 0; i < size; ++i) {
+            new (&inline_slot[i]) Slot<ValueType>();
+        }
+        return inline_slot;
+    }
+
+    void release() {
+        if (isInline()) {
+            for (unsigned i = 0; i < size_table; ++i) {
+                slot[i].~Slot<ValueType>();
+            }
+        } else {
+            delete[] slot;
+        }
+    }
+
+    /**
+     * Takes the slots of @rhs for the move operations. Inline slots
+     * cannot be handed over, so their elements are moved one by one
+     * and the slots of @rhs released.
+     */
+    void takeSlots(HashTable& rhs) {
+        if (rhs.isInline()) {
+            slot = allocate(rhs.size_table);
+            for (unsigned i = 0; i < rhs.size_table; ++i) {
+                slot[i] = std::move(rhs.slot[i]);
+            }
+            rhs.release();
+        } else {
+            slot = rhs.slot;
+        }
+    }
+
+    /**
+     * Returns the smallest prime larger than @n.
+     */
+    static unsigned nextPrime(unsigned n) {
+        bool is_prime = false;
+        while(!is_prime) {
+            n++;
+            bool flag_prime = true;
+            for (unsigned i = 2; i * i <= n; ++i) {
+                if (n % i == 0) {
+                    flag_prime = false;
+                    break;
+                }
+            }
+            if(flag_prime) {
+                is_prime = true;
+            }
+        }
+        return n;
+    }
+
+    /**
+     * Moves every live element into a fresh array of @newSize slots,
+     * dropping all deleted markers on the way.
+     */
+    void rebuild(unsigned newSize) {
+        // Moving elements is not a lookup the caller made.
+        HT_STATS(HashTableStats saved = table_stats);
+        if (INLINE_SLOTS > 0 && isInline() && newSize <= INLINE_SLOTS) {
+            rebuildInline(newSize);
+        } else {
+            Slot<ValueType>* old_slot = slot;
+            unsigned size_prev_table = size_table;
+            bool was_inline = isInline();
+
+            slot = allocate(newSize);
+            reinsert(old_slot, size_prev_table, newSize);
+            if (was_inline) {
+                for (unsigned i = 0; i < size_prev_table; ++i) {
+                    old_slot[i].~Slot<ValueType>();
+                }
+            } else {
+                delete[] old_slot;
+            }
+        }
+        HT_STATS(table_stats = saved);
+        HT_STATS(table_stats.rebuilds++);
+    }
+
+    /**
+     * Same as above for an inline table that stays inline. The new
+     * slots are the old ones, so the live elements are moved aside on
+     * the stack first. This lives apart from rebuild() so that other
+     * tables never reserve that storage.
+     */
+    void rebuildInline(unsigned newSize) {
+        alignas(Slot<ValueType>) unsigned char saved_storage[INLINE_BYTES];
+        Slot<ValueType>* saved_slot = reinterpret_cast<Slot<ValueType>*>(saved_storage);
+        unsigned num_saved = 0;
+        for (unsigned i = 0; i < size_table; ++i) {
+            if (!slot[i].is_empty) {
+                new (&saved_slot[num_saved++]) Slot<ValueType>(std::move(slot[i]));
+            }
+        }
+        release();
+
+        slot = allocate(newSize);
+        reinsert(saved_slot, num_saved, newSize);
+        for (unsigned i = 0; i < num_saved; ++i) {
+            saved_slot[i].~Slot<ValueType>();
+        }
+    }
+
+    /**
+     * Empties the table, now @newSize fresh slots, and inserts the
+     * live elements of the @count slots at @from.
+     */
+    void reinsert(const Slot<ValueType>* from, unsigned count, unsigned newSize) {
+        size_table = newSize;
+        num_element = 0;
+        num_deleted = 0;
+        // Re-inserting adds every element back in.
+        fingerprint_sum = 0;
+        for (unsigned i = 0; i < count; ++i) {
+            if (!from[i].is_empty) {
+                insert(from[i].key, from[i].value);
+            }
+        }
+    }
+
     struct Slot<ValueType> *slot;
+    alignas(Slot<ValueType>) unsigned char inline_storage[INLINE_BYTES];
     unsigned size_table;
     unsigned num_element = 0;
+    unsigned num_deleted = 0;
+    // Sum of entryHash() over all elements; stale while the flag is set.
+    unsigned long long fingerprint_sum = 0;
+    bool is_fingerprint_dirty = false;
+#ifdef HASH_TABLE_STATS
+    HashTableStats table_stats;
+#endif
 };
 
 #endif  // HASH_TABLE_HPP
@@ -1,15 +1,77 @@
 #ifndef PRIORITY_QUEUE_HPP
 #define PRIORITY_QUEUE_HPP
+
+/**
+ * Defining PRIORITY_QUEUE_STATS before including this header (or any
+ * header that includes it) turns on operation counters, sift-depth
+ * histograms, position-map probe statistics and a per-operation trace
+ * hook. Without it none of this is compiled in.
+ */
+#ifdef PRIORITY_QUEUE_STATS
+#define PQ_STATS(statement) statement
+#else
+#define PQ_STATS(statement)
+#endif
+
 #include "hash_table.hpp"
+#include <algorithm>
+#include <atomic>
+#include <istream>
 #include <ostream>
-
-template <typename ValueType>
-struct Slot_queue
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef PRIORITY_QUEUE_STATS
+enum PriorityQueueOp
 {
-    unsigned key;
-    ValueType value;
+    PQ_OP_INSERT,
+    PQ_OP_OFFER,
+    PQ_OP_DELETE_MIN,
+    PQ_OP_REMOVE,
+    PQ_OP_DECREASE_KEY,
+    PQ_OP_INCREASE_KEY
 };
 
+/**
+ * Called after every modifying operation with the key it was given
+ * (the removed key for deleteMin()), whether it succeeded, and how
+ * many levels its sifting moved.
+ */
+typedef void (*PriorityQueueTraceHook)(void* context, PriorityQueueOp op,
+                                       unsigned key, bool success, unsigned depth);
+
+struct PriorityQueueStats
+{
+    static const unsigned NUM_DEPTH_BUCKET = 33;
+    // Elements shifted by one level while sifting; each one is what
+    // used to be a swap.
+    unsigned long long moves = 0;
+    // up()/down() calls by number of levels moved.
+    unsigned long long up_depth[NUM_DEPTH_BUCKET] = {};
+    unsigned long long down_depth[NUM_DEPTH_BUCKET] = {};
+    unsigned long long insert_full = 0;
+    unsigned long long insert_duplicate = 0;
+    unsigned long long decrease_rejected = 0;
+    unsigned long long increase_rejected = 0;
+    // Lookups into the key -> value slot map.
+    HashTableStats mapping;
+};
+#endif
+
+/**
+ * Binary min-heap of unsigned keys, each mapped to an instance
+ * of ValueType.
+ *
+ * Keys live in their own dense array in heap order, next to the
+ * index of the slot that holds their value. Sifting only moves keys
+ * and slot indices, so values are copied once on the way in and
+ * never again while the heap reorders. @mapping goes from a key to
+ * its value slot, which does not change while the key is in the
+ * heap, so sifting never touches the hash table either.
+ */
 template <typename ValueType>
 class PriorityQueue
 {
@@ -19,7 +81,7 @@ public:
      *
      * Throws std::runtime_error if @maxSize is 0.
      */
-    explicit PriorityQueue(unsigned maxSize) {
+    explicit PriorityQueue(unsigned maxSize) : mapping(1) {
         size_max = maxSize;
         unsigned prime_num = 2 * maxSize;
 
@@ -27,14 +89,22 @@ public:
             throw std::runtime_error("maxSize cannot be 0.");
         }
 
-        slot = new Slot_queue<ValueType>[maxSize];
+        heap_key = new unsigned[maxSize];
+        heap_slot = new unsigned[maxSize];
+        position = new unsigned[maxSize];
+        value_slot = new ValueType[maxSize];
+
+        // Past the last element, @heap_slot holds the free value slots.
+        for (unsigned i = 0; i < maxSize; ++i) {
+            heap_slot[i] = i;
+        }
 
         bool is_prime = false;
         prime_num--; // For the case where size_max was prime number
         while(!is_prime) {
             prime_num++;
             bool flag_prime = true;
-            for (unsigned i = 2; i < prime_num; ++i) {
+            for (unsigned i = 2; i * i <= prime_num; ++i) {
                 if (prime_num % i == 0) {
                     flag_prime = false;
                     break;
@@ -45,38 +115,33 @@ public:
             }
         }
 
-        mapping = new HashTable<unsigned> (prime_num);
+        mapping = HashTable<unsigned>(prime_num);
     }
 
     ~PriorityQueue() {
-        delete[] slot;
-        // delete mapping;
+        delete[] heap_key;
+        delete[] heap_slot;
+        delete[] position;
+        delete[] value_slot;
     }
 
     /**
      * Makes the underlying implementation details (including the max size) look
      * exactly the same as that of @rhs.
      */
-    PriorityQueue(const PriorityQueue& rhs) {
-        slot = new struct Slot_queue<ValueType>[rhs.size_max];
-        size_max = rhs.size_max;
-        num_element = rhs.num_element;
-
-        for (std::size_t i = 0; i < size_max; ++i) {
-            slot[i] = rhs.slot[i];
-        }
-        mapping = rhs.mapping;
+    PriorityQueue(const PriorityQueue& rhs) : mapping(1) {
+        copyFrom(rhs);
     }
 
     PriorityQueue& operator=(const PriorityQueue& rhs) {
-        slot = new struct Slot_queue<ValueType>[rhs.size_max];
-        size_max = rhs.size_max;
-        num_element = rhs.num_element;
-
-        for (std::size_t i = 0; i < size_max; ++i) {
-            slot[i] = rhs.slot[i];
+        if (this == &rhs) {
+            return *this;
         }
-        mapping = rhs.mapping;
+        delete[] heap_key;
+        delete[] heap_slot;
+        delete[] position;
+        delete[] value_slot;
+        copyFrom(rhs);
         return *this;
     }
 
@@ -85,22 +150,19 @@ public:
      * and gives them to "this" object.
      * After this, @rhs should be in a "moved from" state.
      */
-    PriorityQueue(PriorityQueue&& rhs) noexcept {
-        slot = rhs.slot;
-        size_max = rhs.size_max;
-        num_element = rhs.num_element;
-        rhs.slot = nullptr;
-        rhs.size_max = 0;
-        rhs.num_element = 0;
+    PriorityQueue(PriorityQueue&& rhs) noexcept : mapping(1) {
+        moveFrom(rhs);
     }
 
     PriorityQueue& operator=(PriorityQueue&& rhs) noexcept {
-        slot = rhs.slot;
-        size_max = rhs.size_max;
-        num_element = rhs.num_element;
-        rhs.slot = nullptr;
-        rhs.size_max = 0;
-        rhs.num_element = 0;
+        if (this == &rhs) {
+            return *this;
+        }
+        delete[] heap_key;
+        delete[] heap_slot;
+        delete[] position;
+        delete[] value_slot;
+        moveFrom(rhs);
 
         return *this;
     }
@@ -126,7 +188,7 @@ public:
         unsigned x = 0;
         unsigned y = 2;
         for (unsigned i = 0; i < pq.num_element; ++i) {
-            os << "(" << pq.slot[i].key << "," << pq.slot[i].value << ") ";
+            os << "(" << pq.heap_key[i] << "," << pq.value_slot[pq.heap_slot[i]] << ") ";
             if (i == x && (i != pq.num_element - 1)) {
                 os << "\n";
                 x = x + y;
@@ -137,60 +199,65 @@ public:
         return os;
     }
 
-    void swap(unsigned index1, unsigned index2) {
-        *(mapping->get(slot[index1].key)) = index2;
-        *(mapping->get(slot[index2].key)) = index1;
-
-        auto tmp = slot[index1];
-        slot[index1] = slot[index2];
-        slot[index2] = tmp;
-    }
-
+    /**
+     * Both of these move a "hole" instead of swapping: the element at
+     * @index is lifted out, the elements it passes are shifted by one
+     * level, and it is written back once at its final position.
+     */
     void up(unsigned index) {
-        if (index == 0) return;
-        unsigned parent = ((index + 1) / 2) - 1;
-        while (slot[parent].key > slot[index].key) {
-            swap(parent, index);
+        unsigned key = heap_key[index];
+        unsigned slot = heap_slot[index];
+        PQ_STATS(unsigned depth = 0);
+
+        while (index > 0) {
+            unsigned parent = ((index + 1) / 2) - 1;
+            if (heap_key[parent] < key) {
+                break;
+            }
+            heap_key[index] = heap_key[parent];
+            heap_slot[index] = heap_slot[parent];
+            position[heap_slot[index]] = index;
             index = parent;
-            if (index == 0) return;
-            parent = ((index + 1) / 2) - 1;
+            PQ_STATS(depth++);
         }
+        PQ_STATS(recordSift(queue_stats.up_depth, depth));
+
+        heap_key[index] = key;
+        heap_slot[index] = slot;
+        position[slot] = index;
     }
 
     void down(unsigned index) {
-        unsigned left_child = 2 * (index + 1) - 1;
-        unsigned right_child = (2 * (index + 1)) + 1 - 1;
-        unsigned small_child;
-        if (slot[left_child].key < slot[right_child].key) {
-            small_child = left_child;
-        } else {
-            small_child = right_child;
-        }
-
-        while (small_child < num_element && slot[index].key > slot[small_child].key) {
-            swap(index, small_child);
-            index = small_child;
-            left_child = 2 * (index + 1) - 1;
-            right_child = (2 * (index + 1)) + 1 - 1;
-
-            if (left_child >= num_element && right_child >= num_element) {
-                return;
+        unsigned key = heap_key[index];
+        unsigned slot = heap_slot[index];
+        PQ_STATS(unsigned depth = 0);
+
+        while (true) {
+            unsigned left_child = 2 * (index + 1) - 1;
+            unsigned right_child = (2 * (index + 1)) + 1 - 1;
+            if (left_child >= num_element) {
+                break;
             }
-            else if (left_child >= num_element && right_child < num_element) {
+
+            unsigned small_child = left_child;
+            if (right_child < num_element && heap_key[right_child] < heap_key[left_child]) {
                 small_child = right_child;
             }
-            else if (left_child < num_element && right_child >= num_element)
-            {
-                small_child = left_child;
-            }
-            else {
-                if (slot[left_child].key < slot[right_child].key) {
-                    small_child = left_child;
-                } else {
-                    small_child = right_child;
-                }
+            if (key < heap_key[small_child]) {
+                break;
             }
+
+            heap_key[index] = heap_key[small_child];
+            heap_slot[index] = heap_slot[small_child];
+            position[heap_slot[index]] = index;
+            index = small_child;
+            PQ_STATS(depth++);
         }
+        PQ_STATS(recordSift(queue_stats.down_depth, depth));
+
+        heap_key[index] = key;
+        heap_slot[index] = slot;
+        position[slot] = index;
     }
 
     /**
@@ -203,23 +270,126 @@ public:
      * or if max size would be exceeded.
      */
     bool insert(unsigned key, const ValueType& value) {
+        PQ_STATS(last_depth = 0);
         if (num_element == size_max) {
+            PQ_STATS(queue_stats.insert_full++);
+            PQ_STATS(trace(PQ_OP_INSERT, key, false));
             return false;
         }
 
-        unsigned* value_address = mapping -> get(key);
+        unsigned* value_address = mapping.get(key);
         if (value_address != nullptr) {
+            PQ_STATS(queue_stats.insert_duplicate++);
+            PQ_STATS(trace(PQ_OP_INSERT, key, false));
             return false;
         }
 
-        slot[num_element].key = key;
-        slot[num_element].value = value;
-        mapping->insert(key,num_element);
+        unsigned slot = heap_slot[num_element];
+        value_slot[slot] = value;
+        heap_key[num_element] = key;
+        mapping.insert(key, slot);
         up(num_element);
         num_element++;
+        PQ_STATS(trace(PQ_OP_INSERT, key, true));
+        return true;
+    }
+
+
+    /**
+     * Top-k insert: keeps the maxSize() largest keys offered so far.
+     *
+     * Behaves like insert() until the priority queue is full. After that,
+     * a key that is not larger than the smallest key is rejected with a
+     * single comparison, and a larger key replaces the smallest element
+     * in one pass down the heap.
+     *
+     * Returns true if the pair was kept.
+     * Returns false if it was rejected or @key is already in the priority queue.
+     */
+    bool offer(unsigned key, const ValueType& value) {
+        if (num_element < size_max) {
+            return insert(key, value);
+        }
+
+        PQ_STATS(last_depth = 0);
+        if (key <= heap_key[0]) {
+            PQ_STATS(trace(PQ_OP_OFFER, key, false));
+            return false;
+        }
+
+        if (mapping.get(key) != nullptr) {
+            PQ_STATS(queue_stats.insert_duplicate++);
+            PQ_STATS(trace(PQ_OP_OFFER, key, false));
+            return false;
+        }
+
+        unsigned slot = heap_slot[0];
+        mapping.remove(heap_key[0]);
+        value_slot[slot] = value;
+        heap_key[0] = key;
+        mapping.insert(key, slot);
+        down(0);
+        PQ_STATS(trace(PQ_OP_OFFER, key, true));
         return true;
     }
 
+    /**
+     * Heap-sorts the elements in place, largest key first, then calls
+     * @visit(key, value) for each of them in that order and leaves the
+     * priority queue empty. Nothing is reallocated.
+     * If @smallestFirst is true, the elements are visited the other way
+     * round, at no extra cost.
+     *
+     * Returns the number of elements visited.
+     */
+    template <typename Visitor>
+    unsigned drainSorted(Visitor visit, bool smallestFirst = false) {
+        unsigned num_sorted = num_element;
+        for (unsigned i = 0; i < num_sorted; ++i) {
+            mapping.remove(heap_key[i]);
+        }
+        sortDescending();
+
+        num_element = 0;
+        for (unsigned i = 0; i < num_sorted; ++i) {
+            unsigned index = smallestFirst ? num_sorted - 1 - i : i;
+            visit(heap_key[index], value_slot[heap_slot[index]]);
+        }
+        return num_sorted;
+    }
+
+    /**
+     * Sorts the elements in place, smallest key first, then calls
+     * @visit(key, value) for each of them in that order. A sorted array
+     * is still a heap, so the priority queue keeps every element and
+     * loses nothing if @visit throws. Nothing is reallocated.
+     *
+     * Returns the number of elements visited.
+     */
+    template <typename Visitor>
+    unsigned visitSorted(Visitor visit) {
+        unsigned num_sorted = num_element;
+        sortDescending();
+        std::reverse(heap_key, heap_key + num_sorted);
+        std::reverse(heap_slot, heap_slot + num_sorted);
+        for (unsigned i = 0; i < num_sorted; ++i) {
+            position[heap_slot[i]] = i;
+        }
+
+        for (unsigned i = 0; i < num_sorted; ++i) {
+            visit(heap_key[i], value_slot[heap_slot[i]]);
+        }
+        return num_sorted;
+    }
+
+    /**
+     * Removes every element. The key map is replaced by an empty one
+     * of the same size instead of removing the keys one by one.
+     */
+    void clear() {
+        mapping = HashTable<unsigned>(mapping.tableSize());
+        num_element = 0;
+    }
 
     /**
      * Returns key of the smallest element in the priority queue
@@ -232,7 +402,7 @@ public:
             return nullptr;
         }
 
-        return &slot[0].key;
+        return &heap_key[0];
     }
 
 
@@ -247,7 +417,7 @@ public:
             return nullptr;
         }
 
-        return &slot[0].value;
+        return &value_slot[heap_slot[0]];
     }
 
 
@@ -258,18 +428,31 @@ public:
      * Returns false if priority queue is empty, i.e. nothing to delete.
      */
     bool deleteMin() {
+        PQ_STATS(last_depth = 0);
         if (num_element == 0) {
+            PQ_STATS(trace(PQ_OP_DELETE_MIN, 0, false));
             return false;
         }
 
-        // The most right bottom slot will move to the root
-        slot[0].key = slot[num_element - 1].key;
-        slot[0].value = slot[num_element - 1].value;
+        unsigned slot = heap_slot[0];
+        PQ_STATS(unsigned removed_key = heap_key[0]);
+        mapping.remove(heap_key[0]);
         num_element--;
+        if (num_element == 0) {
+            PQ_STATS(trace(PQ_OP_DELETE_MIN, removed_key, true));
+            return true;
+        }
+
+        // The most right bottom element will move to the root, and
+        // the freed value slot takes its place past the end.
+        heap_key[0] = heap_key[num_element];
+        heap_slot[0] = heap_slot[num_element];
+        heap_slot[num_element] = slot;
 
         // Move the new root down.
         down(0);
 
+        PQ_STATS(trace(PQ_OP_DELETE_MIN, removed_key, true));
         return true;
     }
 
@@ -281,10 +464,10 @@ public:
      */
     ValueType* get(unsigned key) {
         // when the key exists in the table.
-        unsigned* mp = mapping -> get(key);
+        unsigned* mp = mapping.get(key);
 
         if (mp != nullptr) {
-            return &slot[*mp].value;
+            return &value_slot[*mp];
         }
 
         return nullptr;
@@ -310,44 +493,60 @@ public:
      * has an undefined effect.
      */
     bool decreaseKey(unsigned key, unsigned change) {
-        unsigned* mp1 = mapping -> get(key);
+        PQ_STATS(last_depth = 0);
+        unsigned* mp1 = mapping.get(key);
 
         if (change == 0 || mp1 == nullptr || key < change) {
+            PQ_STATS(queue_stats.decrease_rejected++);
+            PQ_STATS(trace(PQ_OP_DECREASE_KEY, key, false));
             return false;
         }
 
         // Return false if the change would lead to a duplication.
-        unsigned* mp2 = mapping -> get(key - change);
+        unsigned* mp2 = mapping.get(key - change);
         if (mp2 != nullptr) {
+            PQ_STATS(queue_stats.decrease_rejected++);
+            PQ_STATS(trace(PQ_OP_DECREASE_KEY, key, false));
             return false;
         }
 
         // The case which result will be true.
-        mapping->insert(key-change,*mp1);
-        slot[*mp1].key = key - change;
-        up(*mp1);
-        mapping->remove(key);
+        // Inserting may rebuild the table, so do not hold on to @mp1.
+        unsigned slot = *mp1;
+        mapping.remove(key);
+        mapping.insert(key - change, slot);
+        heap_key[position[slot]] = key - change;
+        up(position[slot]);
+        PQ_STATS(trace(PQ_OP_DECREASE_KEY, key, true));
         return true;
     }
 
     bool increaseKey(unsigned key, unsigned change) {
-        unsigned* mp1 = mapping -> get(key);
+        PQ_STATS(last_depth = 0);
+        unsigned* mp1 = mapping.get(key);
 
         if (change == 0 || mp1 == nullptr) {
+            PQ_STATS(queue_stats.increase_rejected++);
+            PQ_STATS(trace(PQ_OP_INCREASE_KEY, key, false));
             return false;
         }
 
         // Return false if the change would lead to a duplication.
-        unsigned* mp2 = mapping -> get(key - change);
+        unsigned* mp2 = mapping.get(key + change);
         if (mp2 != nullptr) {
+            PQ_STATS(queue_stats.increase_rejected++);
+            PQ_STATS(trace(PQ_OP_INCREASE_KEY, key, false));
             return false;
         }
 
         // The case which result will be true.
-        mapping->insert(key + change, *mp1);
-        slot[*mp1].key = key + change;
-        down(*mp1);
-        mapping->remove(key);
+        // Inserting may rebuild the table, so do not hold on to @mp1.
+        unsigned slot = *mp1;
+        mapping.remove(key);
+        mapping.insert(key + change, slot);
+        heap_key[position[slot]] = key + change;
+        down(position[slot]);
+        PQ_STATS(trace(PQ_OP_INCREASE_KEY, key, true));
         return true;
     }
 
@@ -360,31 +559,461 @@ public:
      */
     bool remove(unsigned key)
     {
+        PQ_STATS(last_depth = 0);
         // Find the address of the target key node.
-        unsigned *mp = mapping -> get(key);
+        unsigned *mp = mapping.get(key);
 
         if (mp == nullptr) {
+            PQ_STATS(trace(PQ_OP_REMOVE, key, false));
             return false;
         }
 
-        // Replace it with the most right bottom node.
-        slot[*mp].key = slot[num_element - 1].key;
-        slot[*mp].value = slot[num_element - 1].value;
-        num_element--;
+        unsigned slot = *mp;
+        unsigned index = position[slot];
 
         // Need to modify the hash_table
-        mapping->remove(key);
+        mapping.remove(key);
+        num_element--;
+        if (index == num_element) {
+            PQ_STATS(trace(PQ_OP_REMOVE, key, true));
+            return true;
+        }
+
+        // Replace it with the most right bottom node, and hand the freed
+        // value slot to the position past the end.
+        unsigned moved = heap_slot[num_element];
+        heap_key[index] = heap_key[num_element];
+        heap_slot[index] = moved;
+        heap_slot[num_element] = slot;
 
         // Move the node up or down.
-        up(*mp);
-        down(*mp);
+        up(index);
+        if (position[moved] == index) {
+            down(index);
+        }
+        PQ_STATS(trace(PQ_OP_REMOVE, key, true));
+        return true;
+    }
+
+    /**
+     * Moves every element of @rhs into this priority queue.
+     * If both together would exceed the max size, the max size grows
+     * to the sum of both max sizes.
+     * After this, @rhs should be in a "moved from" state.
+     *
+     * Runs in O(n + m): the elements of @rhs are appended and the whole
+     * array is heapified bottom-up. When @rhs is much smaller than this
+     * priority queue, its elements are sifted up one by one instead.
+     *
+     * Returns true if success.
+     * Returns false if the two priority queues share a key
+     * (in which case neither is changed).
+     */
+    bool merge(PriorityQueue&& rhs) {
+        if (this == &rhs) {
+            return false;
+        }
+
+        for (unsigned i = 0; i < rhs.num_element; ++i) {
+            if (mapping.get(rhs.heap_key[i]) != nullptr) {
+                return false;
+            }
+        }
+
+        if (num_element + rhs.num_element > size_max) {
+            grow(size_max + rhs.size_max);
+        }
+
+        unsigned num_old = num_element;
+        for (unsigned i = 0; i < rhs.num_element; ++i) {
+            unsigned slot = heap_slot[num_element];
+            value_slot[slot] = std::move(rhs.value_slot[rhs.heap_slot[i]]);
+            heap_key[num_element] = rhs.heap_key[i];
+            position[slot] = num_element;
+            mapping.insert(rhs.heap_key[i], slot);
+            num_element++;
+        }
+
+        if (rhs.num_element * 8 < num_old) {
+            for (unsigned i = num_old; i < num_element; ++i) {
+                up(i);
+            }
+        } else {
+            heapify(1);
+        }
+
+        // Let the destructor of a temporary release what is left of @rhs.
+        PriorityQueue drained(std::move(rhs));
         return true;
     }
+    /**
+     * Writes the priority queue to @os in a binary format: a header,
+     * then the keys and then the values, both in heap order.
+     * Values are written byte for byte, so ValueType must be trivially
+     * copyable, and the file only reads back on a machine with the
+     * same byte order.
+     *
+     * Throws std::runtime_error if writing fails.
+     */
+    void save(std::ostream& os) const {
+        static_assert(std::is_trivially_copyable<ValueType>::value,
+                      "save() needs a trivially copyable ValueType");
+
+        unsigned header[4] = {SAVE_MAGIC, size_max, num_element, (unsigned) sizeof(ValueType)};
+        os.write((const char*) header, sizeof(header));
+        os.write((const char*) heap_key, (std::streamsize) num_element * sizeof(unsigned));
+
+        // Values sit in their slots, not in heap order, so gather them
+        // into a buffer to keep the writes large and sequential.
+        const unsigned chunk = 65536;
+        std::vector<ValueType> buffer(num_element < chunk ? num_element : chunk);
+        for (unsigned i = 0; i < num_element; i += chunk) {
+            unsigned n = num_element - i < chunk ? num_element - i : chunk;
+            for (unsigned j = 0; j < n; ++j) {
+                buffer[j] = value_slot[heap_slot[i + j]];
+            }
+            os.write((const char*) buffer.data(), (std::streamsize) n * sizeof(ValueType));
+        }
+
+        if (!os) {
+            throw std::runtime_error("Failed to write priority queue.");
+        }
+    }
+
+    /**
+     * Reads a priority queue written by save().
+     *
+     * The keys are already in heap order, so nothing is sifted: the
+     * arrays are read in one go and the key map is filled in a single
+     * pass. The heap order is still checked, which costs one comparison
+     * per element.
+     *
+     * Throws std::runtime_error if reading fails or the data is not a
+     * valid priority queue of this ValueType.
+     */
+    static PriorityQueue load(std::istream& is) {
+        static_assert(std::is_trivially_copyable<ValueType>::value,
+                      "load() needs a trivially copyable ValueType");
+
+        unsigned header[4];
+        is.read((char*) header, sizeof(header));
+        if (!is || header[0] != SAVE_MAGIC || header[3] != sizeof(ValueType) ||
+            header[2] > header[1]) {
+            throw std::runtime_error("Not a saved priority queue of this type.");
+        }
+
+        PriorityQueue pq(header[1]);
+        unsigned n = header[2];
+        is.read((char*) pq.heap_key, (std::streamsize) n * sizeof(unsigned));
+        // A fresh queue has heap_slot[i] == i, so the values go straight
+        // into their slots.
+        is.read((char*) pq.value_slot, (std::streamsize) n * sizeof(ValueType));
+        if (!is) {
+            throw std::runtime_error("Saved priority queue is truncated.");
+        }
+
+        for (unsigned i = 1; i < n; ++i) {
+            if (pq.heap_key[((i + 1) / 2) - 1] > pq.heap_key[i]) {
+                throw std::runtime_error("Saved priority queue is not a heap.");
+            }
+        }
+        for (unsigned i = 0; i < n; ++i) {
+            pq.position[i] = i;
+            if (!pq.mapping.insert(pq.heap_key[i], i)) {
+                throw std::runtime_error("Saved priority queue has duplicate keys.");
+            }
+        }
+        pq.num_element = n;
+        return pq;
+    }
+
+    /**
+     * Builds a priority queue that can have at most @maxSize elements
+     * from the @count keys in @keys and their values in @values,
+     * using @numThreads threads.
+     *
+     * The arrays are copied in, the key map is filled with
+     * HashTable::insertAll(), and the heap is built bottom-up with each
+     * thread sifting its own disjoint subtrees level by level. All
+     * three steps split their work over the @numThreads threads.
+     *
+     * Throws std::runtime_error if @maxSize is 0, @count is larger than
+     * @maxSize, or @keys has duplicates.
+     */
+    static PriorityQueue build(const unsigned* keys, const ValueType* values,
+                               unsigned count, unsigned maxSize,
+                               unsigned numThreads = 1) {
+        if (count > maxSize) {
+            throw std::runtime_error("count cannot be larger than maxSize.");
+        }
+
+        PriorityQueue pq(maxSize);
+        pq.num_element = count;
+
+        // A fresh queue has heap_slot[i] == i, so element i goes into
+        // value slot i, and that stays its slot however it is sifted.
+        if (!pq.mapping.insertAll(keys, count, [](unsigned i) { return i; }, numThreads)) {
+            throw std::runtime_error("Keys to build from are not unique.");
+        }
+
+        parallelFor(count, numThreads, [&pq, keys, values](unsigned begin, unsigned end) {
+            for (unsigned i = begin; i < end; ++i) {
+                pq.heap_key[i] = keys[i];
+                pq.value_slot[i] = values[i];
+                pq.position[i] = i;
+            }
+        });
+        pq.heapify(numThreads);
+        return pq;
+    }
+
+    /**
+     * Checks that every key is no smaller than its parent, and that the
+     * position map and the key map agree with the heap, splitting the
+     * work over @numThreads threads. Meant for debugging; runs in O(n).
+     *
+     * Returns true if the priority queue is consistent.
+     */
+    bool verifyHeap(unsigned numThreads = 1) const {
+        // Lookups would race on the shared probe counters.
+        HT_STATS(numThreads = 1);
+        if (mapping.numElements() != num_element) {
+            return false;
+        }
+
+        std::atomic<bool> is_valid{true};
+        parallelFor(num_element, numThreads, [this, &is_valid](unsigned begin, unsigned end) {
+            for (unsigned i = begin; i < end; ++i) {
+                unsigned slot = heap_slot[i];
+                const unsigned* mapped = mapping.get(heap_key[i]);
+                if ((i > 0 && heap_key[((i + 1) / 2) - 1] > heap_key[i]) ||
+                    position[slot] != i || mapped == nullptr || *mapped != slot) {
+                    is_valid.store(false, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        });
+        return is_valid.load();
+    }
+
+#ifdef PRIORITY_QUEUE_STATS
+    PriorityQueueStats stats() const {
+        PriorityQueueStats result = queue_stats;
+        result.mapping = mapping.stats();
+        return result;
+    }
+    void resetStats() {
+        queue_stats = PriorityQueueStats();
+        mapping.resetStats();
+    }
+    void setTraceHook(PriorityQueueTraceHook hook, void* context) {
+        trace_hook = hook;
+        trace_context = context;
+    }
+#endif
+
 private:
-    struct Slot_queue<ValueType> *slot;
-    HashTable<unsigned> *mapping;
+    static const unsigned SAVE_MAGIC = 0x31305150;  // "PQ01"
+
+#ifdef PRIORITY_QUEUE_STATS
+    void recordSift(unsigned long long* histogram, unsigned depth) {
+        queue_stats.moves += depth;
+        last_depth += depth;
+        histogram[depth < PriorityQueueStats::NUM_DEPTH_BUCKET
+                  ? depth : PriorityQueueStats::NUM_DEPTH_BUCKET - 1]++;
+    }
+
+    void trace(PriorityQueueOp op, unsigned key, bool success) {
+        if (trace_hook != nullptr) {
+            trace_hook(trace_context, op, key, success, last_depth);
+        }
+    }
+#endif
+
+    /**
+     * Heap-sorts the elements in place, largest key first. The key map
+     * is left alone and the position map goes stale, so the caller has
+     * to rebuild it or empty the queue.
+     */
+    void sortDescending() {
+        unsigned num_sorted = num_element;
+        // Move the root behind the shrinking heap, then sift the new root
+        // down. Only keys and slot indices move, never values.
+        for (unsigned end = num_sorted; end > 1; --end) {
+            std::swap(heap_key[0], heap_key[end - 1]);
+            std::swap(heap_slot[0], heap_slot[end - 1]);
+            num_element = end - 1;
+            down(0);
+        }
+        num_element = num_sorted;
+    }
+
+    /**
+     * Restores the heap order of all num_element elements bottom-up.
+     *
+     * With more than one thread, the nodes a few levels below the root
+     * split the heap into disjoint subtrees, and each thread sifts down
+     * a contiguous batch of them. The nodes of a batch on any one level
+     * are contiguous too, so each thread walks its share level by level
+     * without touching anyone else's. The few levels above are done
+     * afterwards on the calling thread.
+     */
+    void heapify(unsigned numThreads) {
+        // down() would race on the shared sift counters.
+        PQ_STATS(numThreads = 1);
+
+        unsigned depth = 0;
+        while (numThreads > 1 && depth < 31 && (1u << depth) < 4 * numThreads) {
+            depth++;
+        }
+        unsigned first_root = (1u << depth) - 1;
+        if (numThreads <= 1 || first_root >= num_element / 2) {
+            for (unsigned i = num_element / 2; i > 0; --i) {
+                down(i - 1);
+            }
+            return;
+        }
+
+        parallelFor(first_root + 1, numThreads, [this, first_root](unsigned begin, unsigned end) {
+            // [low, high) are the nodes below roots [begin, end) on one level.
+            unsigned long long low[32];
+            unsigned long long high[32];
+            unsigned num_level = 0;
+            low[0] = first_root + begin;
+            high[0] = first_root + end;
+            while (low[num_level] < num_element) {
+                low[num_level + 1] = 2 * low[num_level] + 1;
+                high[num_level + 1] = 2 * high[num_level] + 1;
+                num_level++;
+            }
+
+            for (unsigned level = num_level; level > 0; --level) {
+                unsigned long long last = high[level - 1] < num_element ? high[level - 1] : num_element;
+                for (unsigned long long i = last; i > low[level - 1]; --i) {
+                    down((unsigned)(i - 1));
+                }
+            }
+        });
+
+        for (unsigned i = first_root; i > 0; --i) {
+            down(i - 1);
+        }
+    }
+
+    /**
+     * Splits [0, @count) into @numThreads contiguous chunks and calls
+     * @work(begin, end) on each, one of them on the calling thread.
+     */
+    template <typename Work>
+    static void parallelFor(unsigned count, unsigned numThreads, Work work) {
+        if (numThreads > count) {
+            numThreads = count;
+        }
+        if (numThreads <= 1) {
+            work(0u, count);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        try {
+            for (unsigned t = 1; t < numThreads; ++t) {
+                unsigned begin = (unsigned)((unsigned long long) count * t / numThreads);
+                unsigned end = (unsigned)((unsigned long long) count * (t + 1) / numThreads);
+                workers.emplace_back(work, begin, end);
+            }
+            work(0u, (unsigned)((unsigned long long) count / numThreads));
+        } catch (...) {
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+            throw;
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * Reallocates the arrays to hold @maxSize elements, keeping the
+     * elements and their value slots.
+     */
+    void grow(unsigned maxSize) {
+        unsigned* new_key = new unsigned[maxSize];
+        unsigned* new_slot = new unsigned[maxSize];
+        unsigned* new_position = new unsigned[maxSize];
+        ValueType* new_value = new ValueType[maxSize];
+
+        for (unsigned i = 0; i < size_max; ++i) {
+            new_slot[i] = heap_slot[i];
+        }
+        for (unsigned i = size_max; i < maxSize; ++i) {
+            new_slot[i] = i;
+        }
+        for (unsigned i = 0; i < num_element; ++i) {
+            new_key[i] = heap_key[i];
+            new_position[heap_slot[i]] = i;
+            new_value[heap_slot[i]] = std::move(value_slot[heap_slot[i]]);
+        }
+
+        delete[] heap_key;
+        delete[] heap_slot;
+        delete[] position;
+        delete[] value_slot;
+        heap_key = new_key;
+        heap_slot = new_slot;
+        position = new_position;
+        value_slot = new_value;
+        size_max = maxSize;
+    }
+
+    void copyFrom(const PriorityQueue& rhs) {
+        size_max = rhs.size_max;
+        num_element = rhs.num_element;
+        heap_key = new unsigned[size_max];
+        heap_slot = new unsigned[size_max];
+        position = new unsigned[size_max];
+        value_slot = new ValueType[size_max];
+
+        for (std::size_t i = 0; i < size_max; ++i) {
+            heap_slot[i] = rhs.heap_slot[i];
+        }
+        for (std::size_t i = 0; i < num_element; ++i) {
+            heap_key[i] = rhs.heap_key[i];
+            position[heap_slot[i]] = i;
+            value_slot[heap_slot[i]] = rhs.value_slot[heap_slot[i]];
+        }
+        mapping = rhs.mapping;
+    }
+
+    void moveFrom(PriorityQueue& rhs) noexcept {
+        heap_key = rhs.heap_key;
+        heap_slot = rhs.heap_slot;
+        position = rhs.position;
+        value_slot = rhs.value_slot;
+        mapping = std::move(rhs.mapping);
+        size_max = rhs.size_max;
+        num_element = rhs.num_element;
+        rhs.heap_key = nullptr;
+        rhs.heap_slot = nullptr;
+        rhs.position = nullptr;
+        rhs.value_slot = nullptr;
+        rhs.size_max = 0;
+        rhs.num_element = 0;
+    }
+
+    unsigned *heap_key;
+    unsigned *heap_slot;
+    unsigned *position;
+    ValueType *value_slot;
+    HashTable<unsigned> mapping;
     unsigned num_element = 0;
     unsigned size_max;
+#ifdef PRIORITY_QUEUE_STATS
+    PriorityQueueStats queue_stats;
+    PriorityQueueTraceHook trace_hook = nullptr;
+    void* trace_context = nullptr;
+    unsigned last_depth = 0;
+#endif
 };
 
 #endif  // PRIORITY_QUEUE_HPP
\ No newline at end of file
@@ -0,0 +1,430 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+#include "priority_queue.hpp"
+#include <climits>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Implementation of a hierarchical timing wheel that holds
+ * timers, each mapping a deadline to an instance of ValueType.
+ *
+ * Time is counted in ticks. The wheel has WHEEL_LEVELS levels
+ * of WHEEL_SLOTS buckets; a bucket on level l covers
+ * WHEEL_SLOTS^l ticks. Timers further than WHEEL_SPAN ticks away
+ * wait in a PriorityQueue keyed on their deadline, and are moved
+ * onto the wheel once they come within range. That queue is keyed
+ * on the deadline minus a base tick that trails the clock, so the
+ * order of far timers survives the tick counter wrapping around.
+ *
+ * schedule(), cancel() and reschedule() run in constant time
+ * for deadlines on the wheel. Timers due on the same tick expire
+ * as one batch.
+ *
+ * Deadlines are expected to lie less than 2^31 ticks after the
+ * current time.
+ */
+
+template <typename ValueType>
+struct Slot_timer
+{
+    unsigned deadline;
+    ValueType value;
+    unsigned prev;
+    unsigned next;
+    unsigned bucket;
+};
+
+template <typename ValueType>
+class TimerWheel
+{
+public:
+    static const unsigned INVALID_TIMER = UINT_MAX;
+
+    static const unsigned WHEEL_BITS = 8;
+    static const unsigned WHEEL_LEVELS = 3;
+    static const unsigned WHEEL_SLOTS = 1u << WHEEL_BITS;
+    static const unsigned WHEEL_SPAN = 1u << (WHEEL_BITS * WHEEL_LEVELS);
+
+    /**
+     * Creates a timer wheel that can have at most @maxTimers timers,
+     * with its clock starting at @now.
+     *
+     * Throws std::runtime_error if @maxTimers is 0.
+     */
+    explicit TimerWheel(unsigned maxTimers, unsigned now = 0) {
+        if (maxTimers == 0) {
+            throw std::runtime_error("maxTimers cannot be 0.");
+        }
+
+        size_max = maxTimers;
+        now_tick = now;
+        far_base = now;
+        timer = new Slot_timer<ValueType>[maxTimers];
+        far = new PriorityQueue<unsigned>(maxTimers);
+
+        for (unsigned i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; ++i) {
+            bucket_head[i] = NIL;
+        }
+        for (unsigned i = 0; i < WHEEL_LEVELS; ++i) {
+            level_count[i] = 0;
+        }
+
+        // Chain every timer into the free list.
+        for (unsigned i = 0; i < maxTimers; ++i) {
+            timer[i].bucket = FREE_BUCKET;
+            timer[i].next = i + 1 < maxTimers ? i + 1 : NIL;
+        }
+        free_head = 0;
+    }
+
+    ~TimerWheel() {
+        delete[] timer;
+        delete far;
+    }
+
+    TimerWheel(const TimerWheel& rhs) = delete;
+    TimerWheel& operator=(const TimerWheel& rhs) = delete;
+
+    /**
+     * All of these must run in constant time.
+     */
+    unsigned numTimers() const {
+        return num_timer;
+    }
+    unsigned maxTimers() const {
+        return size_max;
+    }
+    unsigned now() const {
+        return now_tick;
+    }
+
+    /**
+     * Starts a timer that expires at tick @deadline and carries @value.
+     * A deadline that is not after now() expires on the next tick.
+     *
+     * Returns the id of the new timer.
+     * Returns INVALID_TIMER if max number of timers would be exceeded.
+     *
+     * The id stays valid until the timer expires or is cancelled.
+     * After that it may be handed out again.
+     */
+    unsigned schedule(unsigned deadline, const ValueType& value) {
+        if (free_head == NIL) {
+            return INVALID_TIMER;
+        }
+
+        unsigned id = free_head;
+        free_head = timer[id].next;
+        timer[id].deadline = deadline;
+        timer[id].value = value;
+        num_timer++;
+
+        place(id, now_tick + 1);
+        return id;
+    }
+
+    /**
+     * Stops timer @id without running it.
+     *
+     * Returns true if success.
+     * Returns false if @id is not a pending timer.
+     */
+    bool cancel(unsigned id) {
+        if (!isPending(id)) {
+            return false;
+        }
+
+        unlink(id);
+        release(id);
+        return true;
+    }
+
+    /**
+     * Moves the deadline of timer @id to @deadline.
+     *
+     * Returns true if success.
+     * Returns false if @id is not a pending timer.
+     */
+    bool reschedule(unsigned id, unsigned deadline) {
+        if (!isPending(id)) {
+            return false;
+        }
+
+        unlink(id);
+        timer[id].deadline = deadline;
+        place(id, now_tick + 1);
+        return true;
+    }
+
+    /**
+     * Returns address of the value carried by timer @id.
+     *
+     * Returns null pointer if @id is not a pending timer.
+     */
+    ValueType* get(unsigned id) {
+        if (!isPending(id)) {
+            return nullptr;
+        }
+        return &timer[id].value;
+    }
+
+    const ValueType* get(unsigned id) const {
+        return ((TimerWheel*) this) -> get(id);
+    }
+
+    /**
+     * Moves the clock forward to @now, calling @onExpire(id, value)
+     * for each timer whose deadline has passed, in deadline order.
+     *
+     * @onExpire may schedule, cancel or reschedule timers, including
+     * the one it was called for. Timers of the same tick that it
+     * cancels or reschedules do not expire.
+     *
+     * Returns the number of expired timers.
+     */
+    template <typename Callback>
+    unsigned advance(unsigned now, Callback onExpire) {
+        unsigned num_expired = 0;
+        if ((int)(now - now_tick) <= 0) {
+            return num_expired;
+        }
+
+        while (now_tick != now) {
+            if (num_timer == 0) {
+                now_tick = now;
+                break;
+            }
+
+            // Nothing can expire before the next turn of the lowest
+            // level that holds timers, so jump straight to it.
+            if (level_count[0] == 0) {
+                unsigned bits = WHEEL_BITS;
+                for (unsigned level = 1;
+                     level < WHEEL_LEVELS - 1 && level_count[level] == 0; ++level) {
+                    bits += WHEEL_BITS;
+                }
+                unsigned skip_to = (((now_tick >> bits) + 1) << bits) - 1;
+                if ((int)(now - skip_to) <= 0) {
+                    now_tick = now;
+                    break;
+                }
+                now_tick = skip_to;
+            }
+
+            now_tick++;
+            cascade();
+
+            // Detach the whole bucket first, so that @onExpire can
+            // change the wheel freely while the batch runs.
+            unsigned index = now_tick & (WHEEL_SLOTS - 1);
+            batch.clear();
+            for (unsigned id = bucket_head[index]; id != NIL; id = timer[id].next) {
+                timer[id].bucket = EXPIRED_BUCKET;
+                batch.push_back(id);
+            }
+            bucket_head[index] = NIL;
+            level_count[0] -= batch.size();
+
+            for (unsigned id : batch) {
+                if (timer[id].bucket != EXPIRED_BUCKET) {
+                    continue;
+                }
+                onExpire(id, timer[id].value);
+                num_expired++;
+                if (timer[id].bucket == EXPIRED_BUCKET) {
+                    release(id);
+                }
+            }
+        }
+        return num_expired;
+    }
+
+private:
+    static const unsigned NIL = UINT_MAX;
+    static const unsigned FAR_BUCKET = WHEEL_LEVELS * WHEEL_SLOTS;
+    static const unsigned EXPIRED_BUCKET = FAR_BUCKET + 1;
+    static const unsigned FREE_BUCKET = FAR_BUCKET + 2;
+    static const unsigned FAR_REBASE = 1u << 30;
+
+    bool isPending(unsigned id) const {
+        return id < size_max && timer[id].bucket != FREE_BUCKET;
+    }
+
+    void release(unsigned id) {
+        timer[id].bucket = FREE_BUCKET;
+        timer[id].next = free_head;
+        free_head = id;
+        num_timer--;
+    }
+
+    /**
+     * Puts timer @id into the bucket that covers its deadline,
+     * treating deadlines before tick @earliest as @earliest.
+     */
+    void place(unsigned id, unsigned earliest) {
+        unsigned when = timer[id].deadline;
+        if ((int)(when - earliest) < 0) {
+            when = earliest;
+        }
+        unsigned delta = when - now_tick;
+
+        if (delta >= WHEEL_SPAN) {
+            placeFar(id);
+            return;
+        }
+
+        unsigned level = 0;
+        while (delta >= (1u << (WHEEL_BITS * (level + 1)))) {
+            level++;
+        }
+        unsigned index = level * WHEEL_SLOTS +
+                         ((when >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+
+        level_count[level]++;
+        timer[id].bucket = index;
+        timer[id].prev = NIL;
+        timer[id].next = bucket_head[index];
+        if (bucket_head[index] != NIL) {
+            timer[bucket_head[index]].prev = id;
+        }
+        bucket_head[index] = id;
+    }
+
+    /**
+     * Far timers with the same deadline share one entry of @far,
+     * whose value is the first timer of their list.
+     */
+    void placeFar(unsigned id) {
+        if (far->numElements() == 0) {
+            far_base = now_tick;
+        }
+        unsigned deadline = timer[id].deadline;
+        unsigned* head = far->get(deadline - far_base);
+
+        timer[id].bucket = FAR_BUCKET;
+        timer[id].prev = NIL;
+        if (head == nullptr) {
+            timer[id].next = NIL;
+            far->insert(deadline - far_base, id);
+        } else {
+            timer[id].next = *head;
+            timer[*head].prev = id;
+            *head = id;
+        }
+    }
+
+    void unlink(unsigned id) {
+        Slot_timer<ValueType>& t = timer[id];
+        if (t.bucket == EXPIRED_BUCKET) {
+            return;
+        }
+        if (t.bucket != FAR_BUCKET) {
+            level_count[t.bucket / WHEEL_SLOTS]--;
+        }
+
+        if (t.next != NIL) {
+            timer[t.next].prev = t.prev;
+        }
+        if (t.prev != NIL) {
+            timer[t.prev].next = t.next;
+        } else if (t.bucket != FAR_BUCKET) {
+            bucket_head[t.bucket] = t.next;
+        } else if (t.next != NIL) {
+            *(far->get(t.deadline - far_base)) = t.next;
+        } else {
+            far->remove(t.deadline - far_base);
+        }
+    }
+
+    /**
+     * Called once the clock reaches a new tick. Whenever a lower level
+     * completes a full turn, the next bucket of the level above is
+     * spread out over the levels below.
+     */
+    void cascade() {
+        if ((now_tick & (WHEEL_SLOTS - 1)) != 0) {
+            return;
+        }
+
+        unsigned top = 1;
+        while (top < WHEEL_LEVELS - 1 &&
+               ((now_tick >> (WHEEL_BITS * top)) & (WHEEL_SLOTS - 1)) == 0) {
+            top++;
+        }
+
+        if (top == WHEEL_LEVELS - 1 &&
+            (now_tick & ((1u << (WHEEL_BITS * top)) - 1)) == 0) {
+            pullFar();
+        }
+
+        for (unsigned level = top; level > 0; --level) {
+            unsigned index = level * WHEEL_SLOTS +
+                             ((now_tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1));
+            unsigned id = bucket_head[index];
+            bucket_head[index] = NIL;
+            while (id != NIL) {
+                unsigned next = timer[id].next;
+                level_count[level]--;
+                place(id, now_tick);
+                id = next;
+            }
+        }
+    }
+
+    /**
+     * Moves far timers that have come within WHEEL_SPAN ticks
+     * onto the wheel.
+     */
+    void pullFar() {
+        if (now_tick - far_base >= FAR_REBASE) {
+            rebaseFar();
+        }
+
+        const unsigned* min = far->getMinKey();
+        while (min != nullptr && *min + far_base - now_tick < WHEEL_SPAN) {
+            unsigned id = *(far->getMinValue());
+            far->deleteMin();
+            while (id != NIL) {
+                unsigned next = timer[id].next;
+                place(id, now_tick);
+                id = next;
+            }
+            min = far->getMinKey();
+        }
+    }
+
+    /**
+     * Re-keys @far on the current tick. Keys are offsets from
+     * @far_base, and deadlines lie less than 2^31 ticks ahead, so
+     * the offsets keep their order as long as the clock stays less
+     * than FAR_REBASE ticks past the base.
+     */
+    void rebaseFar() {
+        std::vector<unsigned> deadline;
+        std::vector<unsigned> head;
+        while (far->numElements() > 0) {
+            deadline.push_back(*(far->getMinKey()) + far_base);
+            head.push_back(*(far->getMinValue()));
+            far->deleteMin();
+        }
+
+        far_base = now_tick;
+        for (unsigned i = 0; i < deadline.size(); ++i) {
+            far->insert(deadline[i] - far_base, head[i]);
+        }
+    }
+
+    struct Slot_timer<ValueType> *timer;
+    PriorityQueue<unsigned> *far;
+    unsigned bucket_head[WHEEL_LEVELS * WHEEL_SLOTS];
+    unsigned level_count[WHEEL_LEVELS];
+    std::vector<unsigned> batch;
+    unsigned free_head;
+    unsigned num_timer = 0;
+    unsigned size_max;
+    unsigned now_tick;
+    unsigned far_base;
+};
+
+#endif  // TIMER_WHEEL_HPP